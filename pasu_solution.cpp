@@ -15,16 +15,36 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
 #include <vector>
 #include <iomanip>
 #include <ctime>
+#include <deque>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std;
 
 /*
  * Enums for all conditions - the room gender policy, the urgency level of
  * requests, the doctoring level of departments, the status tags of patients,
- * and the types of patient rescheduling (movement type).
+ * the types of patient rescheduling (movement type), the ways to generate
+ * the initial solution, and the components of the cost.
  */
 enum Gender {
     MALE, FEMALE
@@ -32,18 +52,38 @@ enum Gender {
 enum GenderPolicy {
     SAME_GENDER, MALE_ONLY, FEMALE_ONLY, TOGETHER
 };
-enum Request {
+enum Request : unsigned char {
     NEEDED, PREFERRED, DONT_CARE
 };
-enum DoctoringLevel {
+enum DoctoringLevel : unsigned char {
     COMPLETE, PARTIAL, NONE
 };
 enum Tag {
     UNREGISTERED, REGISTERED, ADMITTED, DISCHARGED
 };
+enum InstanceShape {
+    SHAPE_AGE_LIMITS = 1, SHAPE_SINGLE_GENDER = 2, SHAPE_SAME_GENDER = 4,
+    SHAPE_VARIABILITY = 8
+};
 enum MoveType {
     CHANGE = 1, SWAP, DELAY, PARTIAL_CHANGE, PARTIAL_SWAP
 };
+enum InitMode {
+    GREEDY_INIT, RANDOM_INIT
+};
+enum PickMode {
+    RANDOM_PICK, WORST_PICK
+};
+enum OutputFormat {
+    TEXT_OUTPUT, COMPACT_OUTPUT, DIFF_OUTPUT
+};
+enum StopReason {
+    NO_STOP, STOP_ITERATIONS, STOP_IDLE, STOP_TIME, STOP_GAP
+};
+enum CostPart {
+    PROPERTY_COST, PREFERENCE_COST, SPECIALISM_COST, GENDER_COST,
+    TRANSFER_COST, DELAY_COST, OVERCROWD_COST, NUM_COST_PARTS
+};
 
 /*
  * Rooms - hospital room struct.
@@ -63,13 +103,10 @@ struct Patients {
     unsigned age;           /* patient age */
     Gender gender;          /* patient gender */
     unsigned rday;          /* request day */
-    unsigned aday;          /* admission day */
     unsigned dday;          /* discharged day */
     unsigned tday;          /* transferred day */
-    unsigned valid_dday;    /* valid delay days */
     unsigned var;           /* variability */
-    unsigned max_aday;      /* admission by this day at the latest */
-    unsigned preferred_cap; /* preferred room cap of a patient */
+    unsigned max_admission; /* maximum admission day given; NO_DAY if '*' */
 };
 
 /*
@@ -84,544 +121,5072 @@ struct Assignments {
     unsigned cost;          /* penalty cost of the assignment */
 };
 
-/* The pre-set penalty weights for actions - the weights of preferred room
- * property, room preference, required specialism, gender policy,
- * transfering, delay of discharging, and room overcrowded risk. */
-unsigned PREFERRED_PROPERTY_WEIGHT = 20, PREFERENCE_WEIGHT = 10,
-        SPECIALISM_WEIGHT = 20, GENDER_WEIGHT = 50, TRANSFER_WEIGHT = 100,
-        DELAY_WEIGHT = 2, OVERCROWD_RISK_WEIGHT = 1;
+/*
+ * Matrix - rows x cols table stored in one contiguous row-major buffer. m[i]
+ * points to row i, so m[i][j] indexes it like a nested vector.
+ */
+template <typename T>
+class Matrix {
+public:
+    Matrix() : num_rows(0), num_cols(0) {}
+
+    void resize(size_t rows, size_t cols, T value) {
+        num_rows = rows;
+        num_cols = cols;
+        cells.assign(rows * cols, value);
+    }
+    void fill(T value) { std::fill(cells.begin(), cells.end(), value); }
+    void append_row(T value) {
+        cells.resize(cells.size() + num_cols, value);
+        num_rows++;
+    }
+    T *operator[](size_t row) { return &cells[row * num_cols]; }
+    const T *operator[](size_t row) const { return &cells[row * num_cols]; }
+    T *data() { return cells.data(); }
+    const T *data() const { return cells.data(); }
+    size_t rows() const { return num_rows; }
+    size_t cols() const { return num_cols; }
 
-/* maximum capacity */
-unsigned MAX_CAPACITY;
+private:
+    vector<T> cells;        /* row-major cells */
+    size_t num_rows;        /* number of rows */
+    size_t num_cols;        /* number of columns */
+};
 
 /*
- * The amount of resources - the numbers of beds, rooms, features in each room,
- * departments, specialisms, patients, scheduling days, total days, and the
- * lower bound of the total penalty cost.
+ * BedTrees - segment trees over the daily free beds, one per room, in flat
+ * node tables. Answers the minimum free beds of a room over a range of days,
+ * and adds to the free beds of a range of days, in O(log D).
  */
-unsigned num_beds, num_rooms, num_features, num_departments, num_specialisms,
-        num_patients, num_days, total_days, lower_bound;
+class BedTrees {
+public:
+    BedTrees() : num_leaves(1) {}
 
-/* total penalty cost of the scheduling */
-unsigned total_cost = 0;
+    void build(const Matrix<unsigned short> &free_beds, unsigned days) {
+        unsigned r, d, i;
+        for (num_leaves = 1; num_leaves < days; num_leaves <<= 1);
+        mins.resize(free_beds.rows(), 2 * num_leaves, PADDING);
+        adds.resize(free_beds.rows(), 2 * num_leaves, 0);
+        for (r = 0; r < free_beds.rows(); r++) {
+            int *m = mins[r];
+            for (d = 0; d < days; d++) m[num_leaves + d] = free_beds[r][d];
+            for (i = num_leaves - 1; i > 0; i--)
+                m[i] = min(m[2 * i], m[2 * i + 1]);
+        }
+    }
 
-/* Result output path. */
-char *outDir = "f:\\result.txt";
-ofstream outFile(outDir, ofstream::out);
+    /* minimum free beds of room r over days [from, to); PADDING if empty */
+    int min_free(unsigned r, unsigned from, unsigned to) const {
+        if (from >= to) return PADDING;
+        return query(mins[r], adds[r], 1, 0, num_leaves, from, to);
+    }
 
-/* Vectors for data collections. */
-vector <vector<bool>> room_property;
-vector <vector<DoctoringLevel>> dept_specialism_level;
-vector <vector<unsigned>> total_patient_room_cost;
-vector <vector<bool>> patient_room_availability;
-vector<unsigned> patient_specialism_needed;
+    /* add value to the free beds of room r over days [from, to) */
+    void add(unsigned r, unsigned from, unsigned to, int value) {
+        if (from < to) update(mins[r], adds[r], 1, 0, num_leaves, from, to,
+                              value);
+    }
 
-vector <vector<Request>> patient_property_level;
-vector <vector<unsigned>> patient_overlap;
+private:
+    static const int PADDING = INT_MAX / 2;
 
-vector <pair<unsigned, unsigned>> department_age_limits;
-vector<unsigned> departments;
-vector<unsigned> specialisms;
-vector<unsigned> room_properties;
+    int query(const int *m, const int *a, unsigned node, unsigned lo,
+              unsigned hi, unsigned from, unsigned to) const {
+        if (to <= lo || hi <= from) return PADDING;
+        if (from <= lo && hi <= to) return m[node];
+        unsigned mid = (lo + hi) / 2;
+        return a[node] + min(query(m, a, 2 * node, lo, mid, from, to),
+                             query(m, a, 2 * node + 1, mid, hi, from, to));
+    }
 
-vector<Rooms *> rooms;
-vector<Patients *> patients;
-vector <vector<unsigned>> schedule;
-vector<Assignments *> assignments;
-vector <vector<unsigned>> beds;
-vector <vector<unsigned>> beds_tempo;
-vector<unsigned> beds_room_id;
+    void update(int *m, int *a, unsigned node, unsigned lo, unsigned hi,
+                unsigned from, unsigned to, int value) {
+        if (to <= lo || hi <= from) return;
+        if (from <= lo && hi <= to) {
+            m[node] += value;
+            a[node] += value;
+            return;
+        }
+        unsigned mid = (lo + hi) / 2;
+        update(m, a, 2 * node, lo, mid, from, to, value);
+        update(m, a, 2 * node + 1, mid, hi, from, to, value);
+        m[node] = a[node] + min(m[2 * node], m[2 * node + 1]);
+    }
 
+    unsigned num_leaves;    /* leaves per tree; days rounded up to 2^k */
+    Matrix<int> mins;       /* node minimum, including the adds below it */
+    Matrix<int> adds;       /* pending add of the node's whole range */
+};
 
 /*
- * compute_overlap - compute patient-patient overlap.
+ * popcount64 - number of set bits of x.
  */
-void compute_overlap() {
-    // for each patient, compute the overlap between her and all other patients.
-    for (unsigned p1 = 0; p1 < num_patients - 1; p1++) {
-        for (unsigned p2 = p1 + 1; p2 < num_patients; p2++) {
-            for (unsigned d = patients[p1]->aday; d < patients[p1]->dday; d++)
-                if (patients[p2]->aday <= d && patients[p2]->dday > d) {
-                    patient_overlap[p1][p2]++;
-                    patient_overlap[p2][p1]++;
-                }
+inline unsigned popcount64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<unsigned>(__popcnt64(x));
+#elif defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_popcountll(x));
+#else
+    unsigned n = 0;
+    for (; x != 0; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+/*
+ * Rng - xoshiro256** pseudo-random number generator, seeded through
+ * splitmix64. One per solver, so threads never share generator state; the
+ * same seed always gives the same sequence.
+ */
+class Rng {
+public:
+    explicit Rng(uint64_t value = 0) { seed(value); }
+
+    void seed(uint64_t value) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t z = (value += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            state[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    /* uniform draw from [0, n) for n > 0, without modulo bias (Lemire's
+     * multiply-and-reject) */
+    unsigned below(unsigned n) {
+        uint64_t m = ((*this)() >> 32) * n;
+        uint32_t low = static_cast<uint32_t>(m);
+        if (low < n) {
+            uint32_t threshold = (0u - n) % n;
+            while (low < threshold) {
+                m = ((*this)() >> 32) * n;
+                low = static_cast<uint32_t>(m);
+            }
         }
+        return static_cast<unsigned>(m >> 32);
     }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state[4];      /* generator state */
 };
 
 /*
- * compute_cost - compute total patient room cost (and availability).
+ * Moves - neighborhood move struct; the new assignments of the moved patients.
  */
-void compute_cost() {
-    // for each patient, calculate all cost for properties, preferences,
-    // spacialism, department age, and gender.
-    for (p = 0; p < num_patients; p++) {
-        sp = patient_specialism_needed[p];
-        for (r = 0; r < num_rooms; r++) {
-            // Properties
-            for (pr = 0; pr < num_features; pr++) {
-                if (patient_property_level[p][pr] == NEEDED &&
-                    !room_property[r][pr])
-                    patient_room_availability[p][r] = false;
-                if (patient_property_level[p][pr] == PREFERRED &&
-                    !room_property[r][pr])
-                    total_patient_room_cost[p][r] += PREFERRED_PROPERTY_WEIGHT;
-            }
+struct Moves {
+    MoveType type;          /* movement type */
+    unsigned p1;            /* first moved patient */
+    unsigned p2;            /* second moved patient; swaps only */
+    Assignments a1;         /* new assignment of p1 */
+    Assignments a2;         /* new assignment of p2 */
+    int delta;              /* change of the total penalty cost */
+};
+
+/*
+ * SwapTabus - tabu swap attribute struct; the two patients may not be swapped
+ * again before the given tabu clock.
+ */
+struct SwapTabus {
+    unsigned p1;            /* lower patient id */
+    unsigned p2;            /* higher patient id */
+    unsigned until;         /* tabu until this tabu clock */
+};
+
+/*
+ * Neighborhoods - state of one neighborhood exploration; the iteration, the
+ * current and best total costs, and the best admissible move found so far;
+ * and the swap partners and the patient queue of the neighborhood modes.
+ */
+struct Neighborhoods {
+    unsigned iter;          /* tabu search iteration */
+    int current_cost;       /* total cost of the current solution */
+    int best_cost;          /* total cost of the best solution */
+    bool found;             /* whether an admissible move was found */
+    bool done;              /* whether to stop exploring (first improvement) */
+    Moves best;             /* best admissible move */
+    unsigned offset;        /* first swap partner of a full scan */
+    const vector<unsigned> *pool;   /* patients the partners come from;
+                                     * all if NULL */
+    vector<unsigned> partners;  /* sampled swap partners; all if empty */
+    vector<pair<unsigned, unsigned> > worst;    /* max-heap of (assignment
+                                                 * cost, patient) left to pick
+                                                 * in this round */
+};
+
+/*
+ * Objectives - the total cost of a solution by component; see CostPart.
+ */
+struct Objectives {
+    int64_t parts[NUM_COST_PARTS];      /* cost of each component */
+};
+
+/*
+ * Instance - all data of a loaded instance; the amount of resources, the
+ * rooms and patients by value, and the precomputed tables. The fields that
+ * the scheduling loops read for every patient are kept as separate arrays.
+ * Read-only once prepared, so solvers can share it.
+ */
+struct Instance {
+    /* The amount of resources - the numbers of beds, rooms, features in each
+     * room, departments, specialisms, patients, scheduling days, total days,
+     * the maximum room capacity, and the lower bound of the total penalty
+     * cost. */
+    unsigned num_beds, num_rooms, num_features, num_departments,
+            num_specialisms, num_patients, num_days, total_days, max_capacity,
+            lower_bound;
+    unsigned shape;                     /* InstanceShape of the features in
+                                         * use, to pick the cost kernels */
 
-            // Preferences
-            if (patients[p]->preferred_cap < rooms[r]->capacity)
-                total_patient_room_cost[p][r] += PREFERENCE_WEIGHT;
+    vector<Rooms> rooms;                /* rooms */
+    vector<Patients> patients;          /* patients, without the hot fields */
 
-            // Specialism
-            unsigned dep;
-            dep = rooms[r]->department;
-            if (dept_specialism_level[dep][sp] == PARTIAL)
-                total_patient_room_cost[p][r] += SPECIALISM_WEIGHT; // * RoomDeptSpecialismLevel(r][sp] * (always 1)
-            if (dept_specialism_level[dep][sp] == NONE)
-                patient_room_availability[p][r] = false;
+    /* Hot patient fields, one array each. */
+    vector<unsigned> aday;              /* admission day */
+    vector<unsigned> valid_dday;        /* discharge day within the horizon */
+    vector<unsigned> max_aday;          /* latest admission day */
+    vector<unsigned> preferred_cap;     /* preferred room capacity */
 
-            // Department age
-            if (department_age_limits[dep].first != 0 &&
-                patients[p]->age < department_age_limits[dep].first)
-                patient_room_availability[p][r] = false;
-            if (department_age_limits[dep].second != 0 &&
-                patients[p]->age > department_age_limits[dep].second)
-                patient_room_availability[p][r] = false;
+    /* Feature sets as bit masks of feature_words 64-bit words per row; the
+     * features of each room, and the NEEDED and the PREFERRED features of
+     * each patient. */
+    unsigned feature_words;
+    Matrix<uint64_t> room_features;
+    Matrix<uint64_t> needed_features;
+    Matrix<uint64_t> preferred_features;
 
-            // Gender
-            if (rooms[r]->policy == MALE_ONLY && patients[p]->gender == FEMALE)
-                total_patient_room_cost[p][r] += GENDER_WEIGHT;
-            if (rooms[r]->policy == FEMALE_ONLY && patients[p]->gender == MALE)
-                total_patient_room_cost[p][r] += GENDER_WEIGHT;
-        }
+    /* Flat tables; room ids and bed counts fit in 16 bits, flags in 8 bits. */
+    Matrix<DoctoringLevel> dept_specialism_level;
+    Matrix<unsigned> total_patient_room_cost;
+    Matrix<unsigned char> patient_room_availability;
+    vector<unsigned> patient_specialism_needed;
+
+    /* Candidate rooms - the available rooms of patient p are candidate_rooms
+     * [candidate_offsets[p], candidate_offsets[p + 1]), cheapest first (by
+     * room id among equal costs). */
+    vector<unsigned> candidate_offsets;
+    vector<unsigned short> candidate_rooms;
+    vector<pair<unsigned, unsigned>> department_age_limits;
+    vector<unsigned> beds_room_id;      /* room of each bed */
+    vector<unsigned> room_first_bed;    /* first bed of each room */
+
+    /* Sparse patient-patient overlap - for o in [overlap_offsets[p],
+     * overlap_offsets[p + 1]), patient p shares overlap_days[o] days of stay
+     * with patient overlap_patients[o]. */
+    vector<unsigned> overlap_offsets;
+    vector<unsigned> overlap_patients;
+    vector<unsigned> overlap_days;
+};
+
+/*
+ * Solver - the state of one solver; its assignments, with the free beds and
+ * the patient counts per room-day they take, the tabu memory and random
+ * number generator. The assignments are the schedule; each patient has at
+ * most two stays, so a patient-day is looked up by room_on_day(), and the
+ * per room-day matrices are the occupancy index. Solvers share the read-only
+ * instance data, so any number of them can search in parallel. When
+ * rescheduling online, the days before today are history, and a repair
+ * search only picks the patients in focus. Every search of a run stops at
+ * its deadline, and the incumbent last written out is kept for streaming.
+ */
+struct Solver {
+    const Instance *inst;               /* instance being solved */
+    vector<Tag> tags;                   /* Tag per patient */
+    Matrix<unsigned short> beds;        /* free beds per room-day */
+    Matrix<unsigned short> beds_tempo;  /* free beds while arranging a day */
+    BedTrees bed_trees;                 /* range index over beds */
+    BedTrees bed_trees_tempo;           /* range index over beds_tempo */
+    Matrix<unsigned short> room_genders;    /* patients per room-day of each
+                                             * gender; row 2 * room + Gender */
+    Matrix<int> gender_sums;            /* prefix sums of gender_step() over
+                                         * the days, [0, d) in column d; row
+                                         * 4 * room + step kind */
+    Matrix<unsigned short> at_risk;     /* patients per room-day who may
+                                         * overstay into it */
+    vector<Assignments> assignments;    /* assignment per patient */
+    Matrix<unsigned> tabu_until;        /* tabu clock until which patient p
+                                         * may not re-enter room r, [p][r],
+                                         * or admission day d, [p][R + d] */
+    vector<SwapTabus> swap_tabu;        /* swapped pairs, hashed */
+    unsigned tabu_clock;                /* tabu search iterations so far */
+    unsigned gender_cost;               /* SAME_GENDER penalty of the rooms */
+    unsigned risk_cost;                 /* overcrowding risk of the rooms */
+    Objectives objectives;              /* running cost by component */
+    unsigned total_cost;                /* total penalty cost */
+    Rng rng;                            /* random number generator */
+    unsigned today;                     /* days before it are fixed */
+    vector<unsigned> focus;             /* patients to repair; all if empty */
+    unsigned window_lo, window_hi;      /* days [lo, hi) the moved patients
+                                         * stay within */
+    chrono::steady_clock::time_point start;     /* start of the run */
+    chrono::steady_clock::time_point deadline;  /* searches stop by then */
+    StopReason stop;                    /* why the last search stopped */
+    ostream *out;                       /* where the run reports to */
+    int streamed_cost;                  /* cost of the incumbent written */
+    chrono::steady_clock::time_point streamed_at;   /* and when */
+};
+
+/*
+ * Elites - a published solution; its total cost and assignments.
+ */
+struct Elites {
+    int cost;                           /* total penalty cost */
+    vector<Assignments> assignments;    /* assignment per patient */
+};
+
+/*
+ * SharedElite - a solution slot shared by the search threads. Solutions are
+ * published and read with atomic shared_ptr operations, so no thread ever
+ * blocks another; a publish only replaces a worse solution, and the cost
+ * only ever goes down to the cost of the published solution.
+ */
+class SharedElite {
+public:
+    SharedElite() : best_cost(INT_MAX) {}
+
+    int cost() const { return best_cost.load(memory_order_acquire); }
+
+    shared_ptr<const Elites> load() const { return atomic_load(&elite); }
+
+    bool publish(int cost, const vector<Assignments> &as) {
+        if (cost >= this->cost()) return false;
+        shared_ptr<Elites> fresh = make_shared<Elites>();
+        fresh->cost = cost;
+        fresh->assignments = as;
+        shared_ptr<const Elites> cur = atomic_load(&elite);
+        shared_ptr<const Elites> next = fresh;
+        do {
+            if (cur && cur->cost <= cost) return false;
+        } while (!atomic_compare_exchange_weak(&elite, &cur, next));
+        // lower the cost only; a slower publisher of a worse elite that
+        // was replaced meanwhile must not store its cost last.
+        int seen = best_cost.load(memory_order_relaxed);
+        while (cost < seen &&
+               !best_cost.compare_exchange_weak(seen, cost,
+                                                memory_order_release,
+                                                memory_order_relaxed));
+        return true;
     }
-}
 
+private:
+    shared_ptr<const Elites> elite;     /* published solution */
+    atomic<int> best_cost;              /* its cost, INT_MAX if none */
+};
 
 /*
- * prep_data - prepare data by reading in from test case file and storing it
- * into corresponding data structures.
+ * Migrations - what one thread of a parallel search shares; the global
+ * incumbent, and the elite slots of all threads. At each migration a thread
+ * looks at the elite of the next thread on a ring and adopts it if better.
  */
-bool prep_data(string fileName) {
-    ifstream is(fileName, ios_base::in);
-    if (!is.is_open()) {
+struct Migrations {
+    SharedElite *incumbent;             /* best solution of all threads */
+    SharedElite *elites;                /* best solution of each thread */
+    unsigned num_threads;               /* number of search threads */
+    unsigned thread;                    /* id of this thread */
+};
+
+/*
+ * BenchRuns - measurements of one benchmark run; one instance, one seed.
+ * Times are in milliseconds.
+ */
+struct BenchRuns {
+    string instance;                    /* instance file */
+    uint64_t seed;                      /* random seed */
+    unsigned patients, rooms, days;     /* instance size */
+    double parse_ms;                    /* read_instance() */
+    double overlap_ms;                  /* compute_overlap() */
+    double cost_ms;                     /* compute_cost(), candidates */
+    double init_ms;                     /* initial solution */
+    double search_ms;                   /* tabu search */
+    bool feasible;                      /* initial solution found */
+    unsigned initial_cost;              /* cost of the initial solution */
+    unsigned iterations;                /* tabu search iterations */
+    unsigned final_cost;                /* cost after the search */
+    unsigned lower_bound;               /* lower bound of the cost */
+};
+
+/*
+ * WorkQueues - a work-stealing task pool over the task ids 0 .. n - 1. The
+ * tasks are dealt to one deque per worker; a worker takes from the front of
+ * its own deque, and when that is empty steals from the back of the others.
+ * Each deque has its own lock, so workers only meet when stealing.
+ */
+class WorkQueues {
+public:
+    WorkQueues(unsigned num_workers, const vector<unsigned> &order)
+        : queues(num_workers) {
+        unsigned i;
+        for (i = 0; i < order.size(); i++)
+            queues[i % num_workers].tasks.push_back(order[i]);
+    }
+
+    /* the next task of worker w; false when all tasks are taken */
+    bool pop(unsigned w, unsigned &task) {
+        unsigned i, n = queues.size();
+        for (i = 0; i < n; i++) {
+            Deques &q = queues[(w + i) % n];
+            lock_guard<mutex> guard(q.lock);
+            if (q.tasks.empty()) continue;
+            if (i == 0) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            } else {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            return true;
+        }
         return false;
     }
 
-    string s, name, gen;
-    const int BUF_SIZE = 256;
-    char buf[BUF_SIZE], ch;
+private:
+    struct Deques {
+        mutex lock;                 /* guards tasks */
+        deque<unsigned> tasks;      /* task ids, in the order to run them */
+    };
+    vector<Deques> queues;          /* one per worker */
+};
 
-    unsigned p, r, pr, d, f, sp, spec;  // id, val, daily_patients = 0, pi = 0,
-    // level, converted_level
+/*
+ * BatchJobs - one instance of a batch; its file, and what solving it left.
+ */
+struct BatchJobs {
+    string instance;                    /* instance file */
+    bool ok;                            /* whether it could be read */
+    vector<BenchRuns> runs;             /* its runs */
+    ostringstream log;                  /* its output and solutions */
+};
 
-    unsigned total_days = 0;
+/*
+ * MicroSizes - the size of a synthetic instance; patients, rooms, days of
+ * the horizon and room features.
+ */
+struct MicroSizes {
+    unsigned patients, rooms, days, features;
+};
 
-    //	read the header
-    is.getline(buf, BUF_SIZE);
-    is >> s >> num_departments;
-    is >> s >> num_rooms;
-    is >> s >> num_features;
-    is >> s >> num_patients;
-    is >> s >> num_specialisms;
-    is >> s >> num_days;
+/*
+ * MicroRuns - measurements of one microbenchmark kernel; the time and the
+ * allocations of ops operations in all.
+ */
+struct MicroRuns {
+    const char *kernel;                 /* kernel name */
+    uint64_t ops;                       /* operations timed */
+    double ns;                          /* nanoseconds, all operations */
+    uint64_t allocations;               /* allocations, all operations */
+};
 
-    num_beds = 0;
+/* The pre-set penalty weights for actions - the weights of preferred room
+ * property, room preference, required specialism, gender policy,
+ * transfering, delay of discharging, and room overcrowded risk. */
+unsigned PREFERRED_PROPERTY_WEIGHT = 20, PREFERENCE_WEIGHT = 10,
+        SPECIALISM_WEIGHT = 20, GENDER_WEIGHT = 50, TRANSFER_WEIGHT = 100,
+        DELAY_WEIGHT = 2, OVERCROWD_RISK_WEIGHT = 1;
 
-    // resize vectors
-    schedule.resize(num_patients, vector<unsigned>(num_days + 1, 199));
-    beds.resize(num_rooms, vector<unsigned>(num_days, NULL));
-    beds_tempo.resize(num_rooms, vector<unsigned>(num_days, NULL));
-
-    room_property.resize(num_rooms, vector<bool>(num_features, false));
-    dept_specialism_level.resize(num_departments,
-                                 vector<DoctoringLevel>(num_specialisms, NONE));
-    department_age_limits.resize(num_departments, make_pair(0, 120));
-    patient_specialism_needed.resize(num_patients);
-    patient_property_level.resize(num_patients,
-                                  vector<Request>(num_features, DONT_CARE));
-    patient_overlap.resize(num_patients, vector<unsigned>(num_patients, 0));
-    total_patient_room_cost.resize(num_patients,
-                                   vector<unsigned>(num_rooms, 0));
-    patient_room_availability.resize(num_patients,
-                                     vector<bool>(num_rooms, true));
+/* Schedule sentinels - no room assigned to a patient-day, and no transfer. */
+const unsigned NO_ROOM = USHRT_MAX, NO_DAY = UINT_MAX;
 
+/* Tabu search parameters - the tabu tenure (in iterations), the maximum
+ * number of iterations, and the number of consecutive iterations without
+ * improvement of the best solution after which the search stops; and the
+ * same two limits for the short repair search after an online event. */
+unsigned TABU_TENURE = 15, MAX_ITERATIONS = 20000, MAX_IDLE_ITERATIONS = 2000,
+        REPAIR_ITERATIONS = 300, REPAIR_IDLE_ITERATIONS = 100;
 
-    // read data of departments
-    is >> ch;
-    is.getline(buf, BUF_SIZE);
-    for (d = 0; d < num_departments; d++) {
-        is >> name >> s;
-        if (s == ">=")
-            is >> department_age_limits[d].first;
-        else if (s == "<=")
-            is >> department_age_limits[d].second;
+/* Largest tabu tenure; the swap tabu table holds 8 tenures, and the stamps
+ * of a search leave room for 2 more. */
+const unsigned MAX_TENURE = 1u << 24;
 
-        is >> ch; // read (
-        do {
-            is >> spec >> ch;
-            dept_specialism_level[d][spec] = COMPLETE;
-        } while (ch == ',');
+/* Run limits - the wall-clock budget of a run in milliseconds from its start
+ * (0 for none), and the number of restarts of the random initial solution.
+ * A search also stops once its best cost is within GAP_LIMIT of the lower
+ * bound, as (cost - lower_bound) / lower_bound; negative for never. */
+unsigned TIME_LIMIT_MS = 0, MAX_RESTARTS = 10000;
+double GAP_LIMIT = -1;
 
+/* Anytime output - the file the best schedule so far is written to while
+ * searching, empty for none, and the least milliseconds between two writes.
+ */
+string INCUMBENT_FILE;
+unsigned INCUMBENT_INTERVAL_MS = 100;
 
-        is >> ch; // read ( or -
-        if (ch == '(')
-            do {
-                is >> spec >> ch;
-                dept_specialism_level[d][spec] = PARTIAL;
-            } while (ch == ',');
-    }
+/* Parallel search parameters - the number of search threads, and the number
+ * of iterations between two elite migrations. */
+unsigned NUM_THREADS = 1, MIGRATION_INTERVAL = 500;
 
-    // read data of rooms
-    unsigned ca, de, b, bt;
-    string na, po;
-    is >> ch;
-    is.getline(buf, BUF_SIZE);
-    for (r = 0; r < num_rooms; r++) {
-        is >> na >> ca >> de >> po;
-
-        Rooms *room = new Rooms;
-        room->name = na;
-        room->capacity = ca;
-        room->department = de;
-        if (po == "Fe") room->policy = FEMALE_ONLY;
-        else if (po == "Ma") room->policy = MALE_ONLY;
-        else if (po == "SG") room->policy = SAME_GENDER;
-        else room->policy = TOGETHER;
+/* Initial solution mode - one greedy pass over the patients, or the random
+ * restarts of generate_ini_solution(). */
+InitMode INIT_MODE = GREEDY_INIT;
 
-        num_beds += room->capacity;
+/* Decomposition - the length in days of the windows the horizon is split
+ * into and solved in parallel before the global search; 0 for none. */
+unsigned WINDOW_DAYS = 0;
 
-        for (d = 0; d < num_days; d++) {
-            beds[r][d] = room->capacity;
-        }
+/* Minimum time of each microbenchmark kernel, in milliseconds. */
+unsigned MICRO_MS = 200;
 
-        is >> ch;
+/* Neighborhood modes - how the patient explored per iteration is picked, at
+ * random or worst assignment cost first; whether the exploration stops at
+ * the first admissible improving move; and the number of random partners
+ * tried by the swap moves, 0 for all patients. */
+PickMode PICK_MODE = RANDOM_PICK;
+bool FIRST_IMPROVEMENT = false;
+unsigned SWAP_SAMPLE = 0;
 
-        if (ch == '(') {
-            do {
-                is >> f >> ch;
-                room_property[r][f] = true;
-            } while (ch != ')');
-        }
-        rooms.push_back(room);
+/* Whether to print the bed of every patient-day after the rooms. */
+bool PRINT_BEDS = false;
 
-    }
+/* Whether to check the running cost against a full recomputation after
+ * every applied move, stopping at the first drift; slow, for testing. */
+bool VERIFY_COST = false;
 
-    beds_room_id.resize(num_beds, NULL);
-    b = 0;
-    bt = 0;
-    for (r = 0; r < num_rooms; r++) {
-        bt = bt + rooms[r]->capacity;
-        for (b; b < bt; b++) {
-            beds_room_id[b] = r;
-        }
-        b = bt;
-    }
+/* Solution output format - the text schedule, the compact assignments, or
+ * the compact assignments changed from a baseline solution. */
+OutputFormat OUTPUT_FORMAT = TEXT_OUTPUT;
 
+/* Result output - stdout, or the file of the --out option, opened once the
+ * options are read. */
+ofstream resultFile;
+ostream outFile(cout.rdbuf());
 
-    // read data of patients
-    is >> ch;
-    is.getline(buf, BUF_SIZE);
-
-    for (p = 0; p < num_patients; p++) {
-        unsigned age, entrance, leave, registration, variability, max_ad,
-                treatment;
-        is >> name >> age >> gen >> ch >> registration >> ch >> entrance >> ch
-           >>
-           leave >> ch >> variability >> ch >> ch;
-        if (ch == '*') // no limit to the max admission
-            max_ad = num_days - (leave - entrance);
-        else {
-            is >> ch >> max_ad;
-        }
-        is >> ch;
-
-        total_days += leave - entrance;
-
-        is >> treatment;
-        patient_specialism_needed[p] = treatment;
-
-        Patients *pat = new Patients;
-        pat->name = name;
-        pat->age = age;
-        pat->rday = registration;
-        pat->aday = entrance;
-        pat->dday = leave;
-        pat->var = variability;
-        pat->max_aday = max_ad;
-        if (leave >= num_days) {
-            pat->valid_dday = num_days;
-        } else {
-            pat->valid_dday = leave;
-        }
-        if (gen == "Fe") pat->gender = FEMALE;
-        else pat->gender = MALE;
+/*
+ * elapsed_ms - milliseconds since start.
+ */
+double elapsed_ms(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                           start).count();
+}
 
-        is >> ch;
-        if (ch == '*')
-            pat->preferred_cap = MAX_CAPACITY;
-        else
-            is >> ch >> pat->preferred_cap;
+/*
+ * Allocation counts - built in only with PASU_MICRO_ALLOC defined, for the
+ * allocations per operation of the microbenchmarks; every operator new of a
+ * thread then counts into thread_allocations. Otherwise the allocations are
+ * not counted, and the standard operators are left alone.
+ */
+#ifdef PASU_MICRO_ALLOC
+const bool COUNT_ALLOCATIONS = true;
+thread_local uint64_t thread_allocations = 0;
 
-        char lev;
-        is >> ch;
-        if (ch == '(') {
-            do {
-                is >> f >> lev >> ch;
-                if (lev == 'n') // needed
-                    patient_property_level[p][f] = NEEDED;
-                else
-                    patient_property_level[p][f] = PREFERRED;
-            } while (ch != ')');
-        }
-        patients.push_back(pat);
+void *operator new(size_t size) {
+    thread_allocations++;
+    void *ptr = malloc(size > 0 ? size : 1);
+    if (ptr == NULL) throw bad_alloc();
+    return ptr;
+}
 
-        Assignments *assignment = new Assignments;
-        assignment->aday = patients[p]->aday;
-        assignment->tday = 99;
-        assignment->dday = patients[p]->valid_dday;
-        assignment->ra = 199;
-        assignment->rb = 199;
-        assignment->cost = 1000000;
-        assignments.push_back(assignment);
-    }
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    thread_allocations++;
+    return malloc(size > 0 ? size : 1);
+}
 
+// GCC takes the free() of these for a mismatch once inlined on a new.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const nothrow_t &) noexcept { free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+const bool COUNT_ALLOCATIONS = false;
+const uint64_t thread_allocations = 0;
+#endif
 
-    // compute patient-patient overlap
-    compute_overlap();
+/*
+ * Instrumentation - event counters and phase timers, built in only with
+ * PASU_INSTRUMENT defined; otherwise COUNT() and PHASE_TIMER() compile to
+ * nothing. Each thread counts into its own Stats, merged when it finishes,
+ * so the hot paths never share a cache line.
+ */
+enum Counter {
+    RESTARTS, FAILED_PLACEMENTS, EVALUATED,     /* EVALUATED + MoveType - 1 */
+    ACCEPTED = EVALUATED + PARTIAL_SWAP, TABU_REJECTED, ASPIRATION_HITS,
+    INFEASIBLE, NUM_COUNTERS
+};
+enum Phase {
+    PHASE_READ, PHASE_OVERLAP, PHASE_COST, PHASE_INIT, PHASE_SEARCH,
+    NUM_PHASES
+};
 
-    // compute total cost for all patients
-    compute_cost();
+#ifdef PASU_INSTRUMENT
+/*
+ * Stats - counter values and phase times (in milliseconds).
+ */
+struct Stats {
+    unsigned long long counts[NUM_COUNTERS];
+    double phase_ms[NUM_PHASES];
+};
 
-    // compute lower bound
-    vector<int> patient_min_cost(num_patients, -1);
-    for (p = 0; p < num_patients; p++) {
-        for (r = 0; r < num_rooms; r++)
-            if (patient_room_availability[p][r]) {
-                if (patient_min_cost[p] == -1 ||
-                    total_patient_room_cost[p][r] <
-                    static_cast<unsigned>(patient_min_cost[p]))
-                    patient_min_cost[p] = total_patient_room_cost[p][r];
-            }
-        if (patient_min_cost[p] == -1) {
-            cerr << "Infeasible for patient " << patients[p]->name << endl;
-        } else
-            lower_bound += static_cast<unsigned>(patient_min_cost[p]) *
-                           (patients[p]->dday - patients[p]->aday);
-    }
-    is >> s;
-    return true;
-}
+thread_local Stats thread_stats;        /* counts of this thread */
+Stats merged_stats;                     /* counts of finished threads */
+mutex stats_mutex;                      /* guards merged_stats */
+
+/* Iterations between two time series rows of the tabu search; 0 for none. */
+unsigned STATS_INTERVAL = 0;
 
 /*
- * reset_schedule - reset data structures for another round of calculation.
+ * PhaseTimers - adds the time from construction to destruction to a phase.
+ */
+class PhaseTimers {
+public:
+    explicit PhaseTimers(Phase phase)
+        : phase(phase), start(chrono::steady_clock::now()) {}
+    ~PhaseTimers() { thread_stats.phase_ms[phase] += elapsed_ms(start); }
+
+private:
+    Phase phase;
+    chrono::steady_clock::time_point start;
+};
+
+#define COUNT(counter) (thread_stats.counts[counter]++)
+#define PHASE_TIMER(phase) PhaseTimers phase_timer(phase)
+
+/*
+ * merge_stats - add the counts of this thread to the merged counts, and
+ * clear them.
  */
-void reset_schedule() {
-    schedule.resize(num_patients, vector<unsigned>(num_days + 1, 199));
-    for (unsigned p = 0; p < num_patients; p++) {
-        schedule[p][0] = UNREGISTERED;
+void merge_stats() {
+    unsigned i;
+    lock_guard<mutex> lock(stats_mutex);
+    for (i = 0; i < NUM_COUNTERS; i++) {
+        merged_stats.counts[i] += thread_stats.counts[i];
+        thread_stats.counts[i] = 0;
+    }
+    for (i = 0; i < NUM_PHASES; i++) {
+        merged_stats.phase_ms[i] += thread_stats.phase_ms[i];
+        thread_stats.phase_ms[i] = 0;
     }
 }
 
+/*
+ * print_stats - print the counts of all threads so far. Phase times of a
+ * parallel search add up the time of every thread.
+ */
+void print_stats(ostream &os) {
+    static const char *counter_names[NUM_COUNTERS] = {
+        "restarts", "failed placements", "evaluated change",
+        "evaluated swap", "evaluated delay", "evaluated partial change",
+        "evaluated partial swap", "accepted", "tabu rejected",
+        "aspiration hits", "infeasible"
+    };
+    static const char *phase_names[NUM_PHASES] = {
+        "read ms", "overlap ms", "cost ms", "initial ms", "search ms"
+    };
+    unsigned i;
+
+    merge_stats();
+    os << "Stats:" << endl;
+    for (i = 0; i < NUM_PHASES; i++)
+        os << "  " << phase_names[i] << " = " << fixed << setprecision(3)
+           << merged_stats.phase_ms[i] << endl;
+    for (i = 0; i < NUM_COUNTERS; i++)
+        os << "  " << counter_names[i] << " = " << merged_stats.counts[i]
+           << endl;
+}
 
 /*
- * update_tempo_room_capacity - copy data for restarting.
+ * print_stats_row - print one time series row of the tabu search; the
+ * iteration, the current and best costs, and the counts of this thread.
  */
-void update_tempo_room_capacity() {
-    unsigned r, d;
-    for (r = 0; r < num_rooms; r++) {
-        for (d = 0; d < num_days; d++) {
-            beds_tempo[r][d] = beds[r][d];
-        }
-    }
+void print_stats_row(ostream &os, unsigned iter, int current, int best) {
+    unsigned i;
+    unsigned long long evaluated = 0;
+    for (i = EVALUATED; i < ACCEPTED; i++) evaluated += thread_stats.counts[i];
+    os << "stats iter = " << iter << ", cost = " << current << ", best = "
+       << best << ", evaluated = " << evaluated << ", accepted = "
+       << thread_stats.counts[ACCEPTED] << ", tabu rejected = "
+       << thread_stats.counts[TABU_REJECTED] << ", aspiration hits = "
+       << thread_stats.counts[ASPIRATION_HITS] << endl;
 }
+#else
+#define COUNT(counter) ((void)0)
+#define PHASE_TIMER(phase) ((void)0)
+
+inline void merge_stats() {}
+inline void print_stats(ostream &) {}
+#endif
 
 /*
- * update_room_capacity - update current room capacity.
+ * compute_overlap - compute patient-patient overlap. Sorting the patients by
+ * admission day, the patients overlapping the stay of a patient are exactly
+ * the ones admitted after it and before its discharge, so the overlapping
+ * pairs are found in O(P log P + K) for K pairs and stored sparsely.
  */
-void update_room_capacity() {
-    unsigned r, d;
-    for (r = 0; r < num_rooms; r++) {
-        for (d = 0; d < num_days; d++) {
-            beds[r][d] = beds_tempo[r][d];
+void compute_overlap(Instance &in) {
+    unsigned i, j, p1, p2, days;
+    vector<unsigned> order(in.num_patients), fill_pos;
+    vector<pair<unsigned, unsigned>> pairs;
+
+    for (i = 0; i < in.num_patients; i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+        return in.aday[x] < in.aday[y];
+    });
+
+    // collect the pairs, and count the overlapping patients of each patient.
+    in.overlap_offsets.assign(in.num_patients + 1, 0);
+    for (i = 0; i < in.num_patients; i++) {
+        p1 = order[i];
+        for (j = i + 1; j < in.num_patients &&
+                        in.aday[order[j]] < in.patients[p1].dday; j++) {
+            p2 = order[j];
+            if (in.patients[p2].dday > in.aday[p2]) {
+                pairs.push_back(make_pair(p1, p2));
+                in.overlap_offsets[p1 + 1]++;
+                in.overlap_offsets[p2 + 1]++;
+            }
         }
     }
+    for (i = 0; i < in.num_patients; i++)
+        in.overlap_offsets[i + 1] += in.overlap_offsets[i];
+
+    // fill the adjacency lists in both directions.
+    in.overlap_patients.resize(in.overlap_offsets[in.num_patients]);
+    in.overlap_days.resize(in.overlap_offsets[in.num_patients]);
+    fill_pos.assign(in.overlap_offsets.begin(), in.overlap_offsets.end() - 1);
+    for (i = 0; i < pairs.size(); i++) {
+        p1 = pairs[i].first;
+        p2 = pairs[i].second;
+        days = min(in.patients[p1].dday, in.patients[p2].dday) -
+               in.aday[p2];
+        in.overlap_patients[fill_pos[p1]] = p2;
+        in.overlap_days[fill_pos[p1]++] = days;
+        in.overlap_patients[fill_pos[p2]] = p1;
+        in.overlap_days[fill_pos[p2]++] = days;
+    }
 }
 
 /*
- * arrange_patients - schedule patient admission.
+ * room_cost_parts - the daily cost of patient p in room r by component, into
+ * parts[PROPERTY_COST .. GENDER_COST]; each preferred feature the room lacks,
+ * a room above the preferred capacity, a department only partially doctoring
+ * the specialism, and a room policy of the other gender. The features are
+ * compared a word of 64 at a time.
  */
-bool arrange_patients(unsigned d) {
-    unsigned p, a, temp, i, aday, valid_dday, ran, room;
-    for (p = 0; p < num_patients; p++) {
-        a = num_rooms;
-        if (d == patients[p]->aday) schedule[p][0] = ADMITTED;
-        else if (d == patients[p]->rday) schedule[p][0] = REGISTERED;
-        else if (d == patients[p]->valid_dday) schedule[p][0] = DISCHARGED;
+void room_cost_parts(const Instance &in, unsigned p, unsigned r,
+                     unsigned parts[]) {
+    const uint64_t *preferred = in.preferred_features[p];
+    const uint64_t *features = in.room_features[r];
+    const Rooms &room = in.rooms[r];
+    Gender g = in.patients[p].gender;
+    unsigned w, missing = 0, sp = in.patient_specialism_needed[p];
 
-        // For all in-hospital patients, search for available beds for them
-        // and update corresponding room status.
-        if ((schedule[p][0] == ADMITTED && d == patients[p]->aday) ||
-            schedule[p][0] == REGISTERED &&
-            patients[p]->aday != patients[p]->rday) {
-            aday = patients[p]->aday;
-            valid_dday = patients[p]->valid_dday;
-            ran = rand() % a;
-
-            // search for available beds for them and update room status.
-            while (ran >= 0) {
-                temp = 0;
-                for (i = aday; i < valid_dday; i++) {
-                    if (beds_tempo[ran][i] < 1) break;
-                    temp++;
-                }
-                if (temp == valid_dday - aday &&
-                    patient_room_availability[p][ran] == true) {
-                    for (i = aday; i < valid_dday; i++) {
-                        schedule[p][i + 1] = ran;
-                        beds_tempo[ran][i]--;
-                    }
-                    break;
-                } else {
-                    if (a > 0) {
-                        ran = --a;
-                        continue;
-                    } else {
-                        // handle failed scheduling
-                        outFile << "Failed p = " << p << endl;
-                        return false;
-                    }
-                }
-            }
-        }
+    for (w = 0; w < in.feature_words; w++)
+        missing += popcount64(preferred[w] & ~features[w]);
+    parts[PROPERTY_COST] = missing * PREFERRED_PROPERTY_WEIGHT;
+    parts[PREFERENCE_COST] = in.preferred_cap[p] < room.capacity
+                             ? PREFERENCE_WEIGHT : 0;
+    parts[SPECIALISM_COST] = in.dept_specialism_level[room.department][sp] ==
+                             PARTIAL ? SPECIALISM_WEIGHT : 0;
+    parts[GENDER_COST] = (g == FEMALE && room.policy == MALE_ONLY) ||
+                         (g == MALE && room.policy == FEMALE_ONLY)
+                         ? GENDER_WEIGHT : 0;
+}
+
+/*
+ * add_patient_shape - add the features patient p uses to the shape; an age
+ * limit of some department it is outside of, and a stay it may overstay.
+ */
+void add_patient_shape(Instance &in, unsigned p) {
+    unsigned d, age = in.patients[p].age;
+    for (d = 0; d < in.department_age_limits.size(); d++) {
+        const pair<unsigned, unsigned> &limit = in.department_age_limits[d];
+        if ((limit.first != 0 && age < limit.first) ||
+            (limit.second != 0 && age > limit.second))
+            in.shape |= SHAPE_AGE_LIMITS;
     }
-    return true;
+    if (in.patients[p].var > 0) in.shape |= SHAPE_VARIABILITY;
 }
 
 /*
- * generate_ini_solution - generate initial solution as the starting point.
+ * compute_shape - find the features the instance uses; age limits that rule
+ * out some patient, rooms taking one gender only, SAME_GENDER rooms, and
+ * patients who may overstay. The cost kernels are specialized on these, so
+ * that an instance pays only for the features it has.
  */
-unsigned generate_ini_solution() {
-    unsigned r, n, da, m, p, t, i, room;
-    for (n = 0; n < 10000; n++) {           /* iteration time: 10000 */
-        t = 1;
+void compute_shape(Instance &in) {
+    unsigned p, r;
+    in.shape = 0;
+    for (r = 0; r < in.num_rooms; r++) {
+        if (in.rooms[r].policy == MALE_ONLY ||
+            in.rooms[r].policy == FEMALE_ONLY)
+            in.shape |= SHAPE_SINGLE_GENDER;
+        if (in.rooms[r].policy == SAME_GENDER) in.shape |= SHAPE_SAME_GENDER;
+    }
+    for (p = 0; p < in.num_patients; p++) add_patient_shape(in, p);
+}
 
-        // reset data structure for the current new scheduling
-        reset_schedule();
+/*
+ * patient_cost_kernel - compute the room costs (and availability) of patient
+ * p; the sum of room_cost_parts(), and the department age. A room lacking a
+ * needed feature is unavailable, as is a department without the specialism.
+ * The gender penalty is looked up by room policy from a table built once for
+ * the patient. Shape drops the gender policy and the age tests of the
+ * instances without them, leaving the room loop free of their branches. The
+ * row is overwritten, so computing it again gives the same costs.
+ */
+template <unsigned Shape>
+void patient_cost_kernel(Instance &in, unsigned p) {
+    unsigned *cost = in.total_patient_room_cost[p];
+    unsigned char *avail = in.patient_room_availability[p];
+    const uint64_t *needed = in.needed_features[p];
+    const uint64_t *preferred = in.preferred_features[p];
+    const Patients &pat = in.patients[p];
+    const unsigned cap = in.preferred_cap[p];
+    unsigned r, w, missing, c, sp = in.patient_specialism_needed[p];
+    unsigned gender_cost[TOGETHER + 1] = {0, 0, 0, 0};
+    uint64_t lacking;
+    bool ok;
 
-        // schedule patient-bed assignment per day
-        for (da = 0; da < num_days && t == 1; da++) {
-            update_tempo_room_capacity();
+    gender_cost[pat.gender == FEMALE ? MALE_ONLY : FEMALE_ONLY] =
+        GENDER_WEIGHT;
+    for (r = 0; r < in.num_rooms; r++) {
+        const uint64_t *features = in.room_features[r];
+        const Rooms &room = in.rooms[r];
+        DoctoringLevel level = in.dept_specialism_level[room.department][sp];
 
-            // if all patients assigned!
-            if (arrange_patients(da)) {
-                for (p = 0; p < num_patients; p++) {
-                    if (schedule[p][0] == REGISTERED &&
-                        patients[p]->aday != patients[p]->rday) {
-                        for (i = patients[p]->aday;
-                             i < patients[p]->valid_dday; i++) {
-                            if (schedule[p][i + 1] != 199) {
-                                room = schedule[p][i + 1];
-                                beds_tempo[room][i]++;
-                            }
-                        }
-                    }
-                }
+        missing = 0;
+        lacking = 0;
+        for (w = 0; w < in.feature_words; w++) {
+            missing += popcount64(preferred[w] & ~features[w]);
+            lacking |= needed[w] & ~features[w];
+        }
+        c = missing * PREFERRED_PROPERTY_WEIGHT +
+            (cap < room.capacity ? PREFERENCE_WEIGHT : 0) +
+            (level == PARTIAL ? SPECIALISM_WEIGHT : 0);
+        if constexpr ((Shape & SHAPE_SINGLE_GENDER) != 0)
+            c += gender_cost[room.policy];
+        cost[r] = c;
 
-                // update room cap for this arrangement and move to next day
-                update_room_capacity();
-            } else {
-                // else, if someone hasn't been assigned a bed, restart this day
-                t = 0;
-            }
+        // Properties and specialism, then department age
+        ok = lacking == 0 && level != NONE;
+        if constexpr ((Shape & SHAPE_AGE_LIMITS) != 0) {
+            const pair<unsigned, unsigned> &age =
+                in.department_age_limits[room.department];
+            ok = ok && (age.first == 0 || pat.age >= age.first) &&
+                 (age.second == 0 || pat.age <= age.second);
         }
+        avail[r] = ok;
+    }
+}
 
-        if (da = num_days - 1 && t == 1) {
-            outFile << "successfully generated an initial solution!" << endl;
-            break;
-        }/* found the initial solution! */
+/*
+ * compute_patient_cost - compute the room costs (and availability) of patient
+ * p, by the kernel for the shape of the instance.
+ */
+void compute_patient_cost(Instance &in, unsigned p) {
+    switch (in.shape & (SHAPE_AGE_LIMITS | SHAPE_SINGLE_GENDER)) {
+    case 0:
+        patient_cost_kernel<0>(in, p);
+        break;
+    case SHAPE_AGE_LIMITS:
+        patient_cost_kernel<SHAPE_AGE_LIMITS>(in, p);
+        break;
+    case SHAPE_SINGLE_GENDER:
+        patient_cost_kernel<SHAPE_SINGLE_GENDER>(in, p);
+        break;
+    default:
+        patient_cost_kernel<SHAPE_AGE_LIMITS | SHAPE_SINGLE_GENDER>(in, p);
+        break;
     }
-    return n;
 }
 
 /*
- * calculate_cost - calculate penalty cost for an assignment.
+ * compute_cost - compute total patient room cost (and availability).
  */
-bool calculate_cost() {
+void compute_cost(Instance &in) {
     unsigned p;
-    for (p = 0; p < num_patients; p++) {
-        assignments[p]->ra = schedule[p][patients[p]->aday + 1];
-        assignments[p]->cost = total_patient_room_cost[p][assignments[p]->ra];
-        total_cost += assignments[p]->cost;
-    }
-    return true;
+    compute_shape(in);
+    for (p = 0; p < in.num_patients; p++) compute_patient_cost(in, p);
 }
 
 /*
- * search_neighborhood_s0 - s0 is the smaller solution space which doesn't
- * allow patient transferring.
- */
-void search_neighborhood_s0() {
-    bool roomFree, samePerson = true;
-    unsigned r, temp, pr, p, d, aday, valid_dday;
-
-    // search for a possible, alternative solution in local space s0.
-    pr = rand() % num_patients;
-    aday = patients[pr]->aday;
-    valid_dday = patients[pr]->valid_dday;
-    for (r = 0; r < num_rooms; r++) {
-        for (d = aday; d < valid_dday; d++) {
-            if (beds[r][d] < 1) {
-                roomFree = false;
-                break;
-            }
-            temp++;
-        }
-        if (temp == valid_dday - aday) {
-            roomFree = true;
+ * append_candidates - append the candidate rooms of patient p, the last
+ * patient with candidates so far, sorted by cost.
+ */
+void append_candidates(Instance &in, unsigned p) {
+    unsigned r, first;
+    const unsigned *cost = in.total_patient_room_cost[p];
 
-        }
-    }
+    if (in.candidate_offsets.empty()) in.candidate_offsets.push_back(0);
+    first = in.candidate_rooms.size();
+    for (r = 0; r < in.num_rooms; r++)
+        if (in.patient_room_availability[p][r])
+            in.candidate_rooms.push_back(r);
+    stable_sort(in.candidate_rooms.begin() + first, in.candidate_rooms.end(),
+                [&](unsigned short x, unsigned short y) {
+                    return cost[x] < cost[y];
+                });
+    in.candidate_offsets.push_back(in.candidate_rooms.size());
 }
 
 /*
- * print_solution - print out the algorithm solution.
+ * compute_candidates - compute the candidate rooms of all patients.
  */
-unsigned print_solution() {
-    unsigned p, d;
-    for (p = 0; p < num_patients; p++) {
-        outFile << "Pat_" << p;
-        outFile << " [" << schedule[p][0] << "]  ";
-        for (d = 0; d < num_days; d++) {
-            if (schedule[p][d + 1] != 199) {
-                outFile << schedule[p][d + 1] << " ";
-            } else {
-                outFile << "-" << " ";
-            }
-        }
-        //	outFile << total_patient_room_cost[p][assignments[p]->ra];
-        outFile << endl;
+void compute_candidates(Instance &in) {
+    unsigned p;
+    in.candidate_offsets.clear();
+    in.candidate_rooms.clear();
+    for (p = 0; p < in.num_patients; p++) append_candidates(in, p);
+}
 
-    }
-    //outFile << "total_cost = " <<total_cost << endl;
-    return 0;
+/*
+ * min_room_cost - the lowest daily room cost of patient p over its available
+ * rooms, -1 if no room is available.
+ */
+int min_room_cost(const Instance &in, unsigned p) {
+    if (in.candidate_offsets[p] == in.candidate_offsets[p + 1]) return -1;
+    return in.total_patient_room_cost[p][in.candidate_rooms[
+                                             in.candidate_offsets[p]]];
 }
 
+
 /*
- * main - the main routine of the program.
+ * Scanner - tokenizer over an instance file read into memory in one block.
+ * Tokens are read in place, without streams. The first malformed token
+ * records an error with its line number; from then on every read fails and
+ * yields 0, an empty word, or '\0'.
  */
-int main() {
-    unsigned p, li = 0;
-    string filename = "F:\\instance\\small_short\\small_short00.pasu";
+class Scanner {
+public:
+    Scanner(const char *text, size_t size)
+        : error_line(0), pos(text), end(text + size), line(1) {}
+
+    /* whitespace-delimited word */
+    void word(const char *&begin, size_t &length, const char *what) {
+        skip_space();
+        begin = pos;
+        while (pos < end && !blank(*pos)) pos++;
+        length = pos - begin;
+        if (length == 0) fail(string("expected ") + what);
+    }
+
+    /* unsigned decimal number */
+    unsigned number(const char *what) {
+        unsigned value = 0;
+        skip_space();
+        if (pos == end || *pos < '0' || *pos > '9') {
+            fail(string("expected ") + what);
+            return 0;
+        }
+        while (pos < end && *pos >= '0' && *pos <= '9')
+            value = value * 10 + (*pos++ - '0');
+        return value;
+    }
+
+    /* single non-blank character */
+    char symbol(const char *what) {
+        skip_space();
+        if (pos == end) {
+            fail(string("expected ") + what);
+            return '\0';
+        }
+        return *pos++;
+    }
 
-    if (!prep_data(filename))
-        cout << "Failed to prepare data!\n";
-    srand(time(0));
-    generate_ini_solution();
-    search_neighborhood_s0();
-    print_solution();
-    calculate_cost();
-    outFile << "Total Cost = " << total_cost << endl;
+    /* skip the rest of the current line */
+    void skip_line() {
+        while (pos < end && *pos != '\n') pos++;
+    }
+
+    /* record message as the error unless condition holds */
+    bool check(bool condition, const string &message) {
+        if (!condition) fail(message);
+        return condition && ok();
+    }
+
+    bool ok() const { return error_line == 0; }
+
+    /* whether only whitespace is left */
+    bool at_end() {
+        skip_space();
+        return pos == end;
+    }
+
+    unsigned error_line;    /* line of the first error, 0 if none */
+    string error;           /* message of the first error */
+
+private:
+    static bool blank(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+               c == '\v' || c == '\f';
+    }
+
+    void skip_space() {
+        while (pos < end && blank(*pos)) {
+            if (*pos == '\n') line++;
+            pos++;
+        }
+    }
+
+    void fail(const string &message) {
+        if (error_line == 0) {
+            error_line = line;
+            error = message;
+        }
+        pos = end;
+    }
+
+    const char *pos;        /* next character */
+    const char *end;        /* end of the text */
+    unsigned line;          /* line of the next character */
+};
+
+/*
+ * same_word - whether the word [begin, begin + length) is s.
+ */
+bool same_word(const char *begin, size_t length, const char *s) {
+    return length == strlen(s) && memcmp(begin, s, length) == 0;
+}
+
+/*
+ * latest_admission - the latest admission day of patient p; the maximum
+ * admission day given, if any, and no later than the last day on which its
+ * whole stay fits in the horizon, but never before its admission day. So a
+ * delay never pushes nights off the horizon.
+ */
+inline unsigned latest_admission(const Instance &in, unsigned p) {
+    const Patients &pat = in.patients[p];
+    unsigned last = in.num_days - min(in.num_days, pat.dday - in.aday[p]);
+    return max(min(last, pat.max_admission), in.aday[p]);
+}
+
+/*
+ * read_patient - read the patient line of patient p; its stay, the admission
+ * limits, the treatment and the room preferences.
+ */
+void read_patient(Scanner &sc, Instance &in, unsigned p) {
+    Patients *pat = &in.patients[p];
+    const char *word;
+    size_t len;
+    char ch, lev;
+    unsigned f, treatment;
+
+    sc.word(word, len, "patient name");
+    pat->name.assign(word, len);
+    pat->age = sc.number("patient age");
+    sc.word(word, len, "patient gender");
+    pat->gender = same_word(word, len, "Fe") ? FEMALE : MALE;
+    sc.symbol("'<'");
+    pat->rday = sc.number("registration day");
+    sc.symbol("','");
+    in.aday[p] = sc.number("admission day");
+    sc.symbol("','");
+    pat->dday = sc.number("discharge day");
+    sc.symbol("','");
+    pat->var = sc.number("variability");
+    sc.symbol("','");
+    sc.check(pat->rday <= in.aday[p] && in.aday[p] <= pat->dday,
+             "days out of order");
+    // no limit to the max admission
+    if (sc.symbol("maximum admission") == '*')
+        pat->max_admission = NO_DAY;
+    else {
+        sc.symbol("'='");
+        pat->max_admission = sc.number("maximum admission day");
+    }
+    sc.symbol("'>'");
+    in.max_aday[p] = latest_admission(in, p);
+
+    in.total_days += pat->dday - in.aday[p];
+
+    treatment = sc.number("treatment");
+    sc.check(treatment < in.num_specialisms, "treatment out of range");
+    in.patient_specialism_needed[p] = treatment;
+
+    if (pat->dday >= in.num_days) {
+        in.valid_dday[p] = in.num_days;
+    } else {
+        in.valid_dday[p] = pat->dday;
+    }
+
+    if (sc.symbol("preferred capacity") == '*')
+        in.preferred_cap[p] = in.max_capacity;
+    else {
+        sc.symbol("'='");
+        in.preferred_cap[p] = sc.number("preferred capacity");
+    }
+
+    ch = sc.symbol("preferred properties");
+    if (ch == '(') {
+        do {
+            f = sc.number("property");
+            lev = sc.symbol("property level");
+            ch = sc.symbol("',' or ')'");
+            if (!sc.check(f < in.num_features, "property out of range"))
+                break;
+            if (lev == 'n') // needed
+                in.needed_features[p][f / 64] |= 1ull << (f % 64);
+            else
+                in.preferred_features[p][f / 64] |= 1ull << (f % 64);
+        } while (ch == ',');
+        sc.check(ch == ')', "expected ')'");
+    }
+}
+
+/*
+ * parse_instance - parse the instance text, NUL-terminated, into the
+ * corresponding data structures; tokenized in place, with rooms and patients
+ * stored in contiguous tables. Malformed input is reported with its line
+ * number, under name.
+ */
+bool parse_instance(Instance &in, vector<char> &text, const string &name) {
+    Scanner sc(&text[0], text.size() - 1);
+    const char *word;
+    size_t len;
+    char ch;
+    unsigned p, r, d, f, spec;
+
+    //	read the header
+    sc.skip_line();
+    sc.word(word, len, "header label");
+    in.num_departments = sc.number("number of departments");
+    sc.word(word, len, "header label");
+    in.num_rooms = sc.number("number of rooms");
+    sc.word(word, len, "header label");
+    in.num_features = sc.number("number of features");
+    sc.word(word, len, "header label");
+    in.num_patients = sc.number("number of patients");
+    sc.word(word, len, "header label");
+    in.num_specialisms = sc.number("number of specialisms");
+    sc.word(word, len, "header label");
+    in.num_days = sc.number("horizon");
+    sc.check(in.num_days > 0, "horizon must be positive");
+    if (!sc.ok()) {
+        cerr << name << ":" << sc.error_line << ": " << sc.error << endl;
+        return false;
+    }
+
+    in.num_beds = 0;
+    in.total_days = 0;
+    in.lower_bound = 0;
+
+    // resize vectors
+    in.feature_words = max(1u, (in.num_features + 63) / 64);
+    in.room_features.resize(in.num_rooms, in.feature_words, 0);
+    in.dept_specialism_level.resize(in.num_departments, in.num_specialisms,
+                                    NONE);
+    in.department_age_limits.resize(in.num_departments, make_pair(0, 120));
+    in.patient_specialism_needed.resize(in.num_patients);
+    in.needed_features.resize(in.num_patients, in.feature_words, 0);
+    in.preferred_features.resize(in.num_patients, in.feature_words, 0);
+    in.total_patient_room_cost.resize(in.num_patients, in.num_rooms, 0);
+    in.patient_room_availability.resize(in.num_patients, in.num_rooms, true);
+    in.rooms.assign(in.num_rooms, Rooms());
+    in.patients.assign(in.num_patients, Patients());
+    in.aday.assign(in.num_patients, 0);
+    in.valid_dday.assign(in.num_patients, 0);
+    in.max_aday.assign(in.num_patients, 0);
+    in.preferred_cap.assign(in.num_patients, 0);
+
+
+    // read data of departments
+    sc.symbol("departments section");
+    sc.skip_line();
+    for (d = 0; d < in.num_departments && sc.ok(); d++) {
+        sc.word(word, len, "department name");
+        sc.word(word, len, "department age limit");
+        if (same_word(word, len, ">="))
+            in.department_age_limits[d].first = sc.number("minimum age");
+        else if (same_word(word, len, "<="))
+            in.department_age_limits[d].second = sc.number("maximum age");
+
+        sc.check(sc.symbol("main specialisms") == '(', "expected '('");
+        do {
+            spec = sc.number("specialism");
+            ch = sc.symbol("',' or ')'");
+            if (sc.check(spec < in.num_specialisms, "specialism out of range"))
+                in.dept_specialism_level[d][spec] = COMPLETE;
+        } while (ch == ',');
+        sc.check(ch == ')', "expected ')'");
+
+        ch = sc.symbol("auxiliary specialisms"); // read ( or -
+        if (ch == '(') {
+            do {
+                spec = sc.number("specialism");
+                ch = sc.symbol("',' or ')'");
+                if (sc.check(spec < in.num_specialisms,
+                             "specialism out of range"))
+                    in.dept_specialism_level[d][spec] = PARTIAL;
+            } while (ch == ',');
+            sc.check(ch == ')', "expected ')'");
+        }
+    }
+
+    // read data of rooms
+    unsigned b, bt;
+    sc.symbol("rooms section");
+    sc.skip_line();
+    in.max_capacity = 0;
+    for (r = 0; r < in.num_rooms && sc.ok(); r++) {
+        Rooms *room = &in.rooms[r];
+        sc.word(word, len, "room name");
+        room->name.assign(word, len);
+        room->capacity = sc.number("room capacity");
+        room->department = sc.number("room department");
+        sc.check(room->department < in.num_departments,
+                 "department out of range");
+        sc.word(word, len, "gender policy");
+        if (same_word(word, len, "Fe")) room->policy = FEMALE_ONLY;
+        else if (same_word(word, len, "Ma")) room->policy = MALE_ONLY;
+        else if (same_word(word, len, "SG")) room->policy = SAME_GENDER;
+        else room->policy = TOGETHER;
+
+        in.num_beds += room->capacity;
+        in.max_capacity = max(in.max_capacity, room->capacity);
+
+        ch = sc.symbol("room features");
+        if (ch == '(') {
+            do {
+                f = sc.number("feature");
+                ch = sc.symbol("',' or ')'");
+                if (sc.check(f < in.num_features, "feature out of range"))
+                    in.room_features[r][f / 64] |= 1ull << (f % 64);
+            } while (ch == ',');
+            sc.check(ch == ')', "expected ')'");
+        }
+    }
+
+    in.beds_room_id.resize(in.num_beds, 0);
+    in.room_first_bed.resize(in.num_rooms, 0);
+    b = 0;
+    bt = 0;
+    for (r = 0; r < in.num_rooms && sc.ok(); r++) {
+        in.room_first_bed[r] = bt;
+        bt = bt + in.rooms[r].capacity;
+        for (; b < bt; b++) {
+            in.beds_room_id[b] = r;
+        }
+    }
+
+
+    // read data of patients
+    sc.symbol("patients section");
+    sc.skip_line();
+
+    for (p = 0; p < in.num_patients && sc.ok(); p++)
+        read_patient(sc, in, p);
+
+    if (!sc.ok()) {
+        cerr << name << ":" << sc.error_line << ": " << sc.error << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * read_instance - read in the test case file and store it into the
+ * corresponding data structures. The file is read in one block and parsed
+ * by parse_instance().
+ */
+bool read_instance(Instance &in, string fileName) {
+    ifstream is(fileName, ios_base::in | ios_base::binary);
+    if (!is.is_open()) {
+        cerr << fileName << ": cannot open file" << endl;
+        return false;
+    }
+    is.seekg(0, ios_base::end);
+    vector<char> text(static_cast<size_t>(is.tellg()) + 1, '\0');
+    is.seekg(0, ios_base::beg);
+    is.read(&text[0], text.size() - 1);
+    is.close();
+    return parse_instance(in, text, fileName);
+}
+
+/*
+ * valid_stay - the days of the stay of patient p within the horizon, the
+ * days an assignment is charged for.
+ */
+inline unsigned valid_stay(const Instance &in, unsigned p) {
+    return in.valid_dday[p] > in.aday[p] ? in.valid_dday[p] - in.aday[p] : 0;
+}
+
+/*
+ * compute_lower_bound - compute the lower bound of the total penalty cost;
+ * every patient in its cheapest room, on time, without transfer, for the
+ * days of its stay within the horizon.
+ */
+void compute_lower_bound(Instance &in) {
+    unsigned p;
+    in.lower_bound = 0;
+    for (p = 0; p < in.num_patients; p++) {
+        int cost = min_room_cost(in, p);
+        if (cost == -1) {
+            cerr << "Infeasible for patient " << in.patients[p].name << endl;
+        } else
+            in.lower_bound += static_cast<unsigned>(cost) * valid_stay(in, p);
+    }
+}
+
+/*
+ * prep_data - prepare data by reading in from test case file and storing it
+ * into corresponding data structures, then precompute the overlap, the room
+ * costs and the lower bound.
+ */
+bool prep_data(Instance &in, string fileName) {
+    {
+        PHASE_TIMER(PHASE_READ);
+        if (!read_instance(in, fileName)) return false;
+    }
+
+    // compute patient-patient overlap
+    {
+        PHASE_TIMER(PHASE_OVERLAP);
+        compute_overlap(in);
+    }
+
+    // compute total cost for all patients, and their candidate rooms
+    {
+        PHASE_TIMER(PHASE_COST);
+        compute_cost(in);
+        compute_candidates(in);
+    }
+
+    // compute lower bound
+    compute_lower_bound(in);
+    return true;
+}
+
+/*
+ * Instance cache - the prepared instance in a versioned binary file, so that
+ * a rerun skips the parsing and the precomputation. The file starts with a
+ * CacheHeaders, then holds every array of the instance in a fixed order, each
+ * as its element count and its elements, padded to 8 bytes so that every
+ * array is aligned in the file. The header records the source file and the
+ * weights the costs were computed with, and a checksum of the arrays; a cache
+ * that does not match them is stale or corrupt, and rebuilt.
+ */
+const char CACHE_MAGIC[8] = {'P', 'A', 'S', 'U', 'B', 'I', 'N', '\0'};
+const uint32_t CACHE_VERSION = 4, CACHE_BYTE_ORDER = 0x01020304;
+
+/*
+ * CacheHeaders - header of an instance cache file.
+ */
+struct CacheHeaders {
+    char magic[8];              /* CACHE_MAGIC */
+    uint32_t version;           /* CACHE_VERSION */
+    uint32_t byte_order;        /* CACHE_BYTE_ORDER as written */
+    uint64_t source_size;       /* size of the instance file */
+    int64_t source_time;        /* its last write time */
+    uint32_t weights[7];        /* the penalty weights */
+    uint32_t counts[11];        /* the amounts of resources, feature_words */
+    uint64_t checksum;          /* fnv1a() of the arrays after the header */
+};
+
+/*
+ * fnv1a - the 64-bit FNV-1a hash of the n bytes at data.
+ */
+uint64_t fnv1a(const char *data, size_t n) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/*
+ * cache_header - the header of the cache of fileName for the current
+ * weights; false if the file cannot be found.
+ */
+bool cache_header(string fileName, CacheHeaders &h) {
+    error_code ec;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.version = CACHE_VERSION;
+    h.byte_order = CACHE_BYTE_ORDER;
+    h.source_size = filesystem::file_size(fileName, ec);
+    if (ec) return false;
+    h.source_time = filesystem::last_write_time(fileName, ec)
+                        .time_since_epoch().count();
+    if (ec) return false;
+    h.weights[0] = PREFERRED_PROPERTY_WEIGHT;
+    h.weights[1] = PREFERENCE_WEIGHT;
+    h.weights[2] = SPECIALISM_WEIGHT;
+    h.weights[3] = GENDER_WEIGHT;
+    h.weights[4] = TRANSFER_WEIGHT;
+    h.weights[5] = DELAY_WEIGHT;
+    h.weights[6] = OVERCROWD_RISK_WEIGHT;
+    return true;
+}
+
+/*
+ * put_array - append n elements to the cache buffer, after their count.
+ */
+template <typename T>
+void put_array(vector<char> &buf, const T *a, uint64_t n) {
+    const char *bytes = reinterpret_cast<const char *>(&n);
+    buf.insert(buf.end(), bytes, bytes + sizeof(n));
+    bytes = reinterpret_cast<const char *>(a);
+    buf.insert(buf.end(), bytes, bytes + n * sizeof(T));
+    buf.resize((buf.size() + 7) / 8 * 8, '\0');
+}
+
+template <typename T>
+void put_vector(vector<char> &buf, const vector<T> &v) {
+    put_array(buf, v.data(), v.size());
+}
+
+template <typename T>
+void put_matrix(vector<char> &buf, const Matrix<T> &m) {
+    uint64_t shape[2] = {m.rows(), m.cols()};
+    put_array(buf, shape, 2);
+    put_array(buf, m.data(), m.rows() * m.cols());
+}
+
+/*
+ * CacheReader - reader of the arrays of a cache file read into memory in one
+ * block. A truncated or malformed array fails it; from then on every read
+ * fails and yields empty arrays.
+ */
+class CacheReader {
+public:
+    CacheReader(const char *data, size_t size)
+        : pos(data), end(data + size), failed(false) {}
+
+    /* the next array, of exactly n elements unless n is ANY */
+    template <typename T>
+    void get_vector(vector<T> &v, uint64_t n = ANY) {
+        uint64_t count = 0;
+        v.clear();
+        if (!take(&count, sizeof(count)) || (n != ANY && count != n) ||
+            count > static_cast<uint64_t>(end - pos) / sizeof(T)) {
+            fail();
+            return;
+        }
+        v.resize(count);
+        take(v.data(), count * sizeof(T));
+        pos += min(static_cast<uint64_t>(end - pos),
+                   (8 - count * sizeof(T) % 8) % 8);
+    }
+
+    template <typename T>
+    void get_matrix(Matrix<T> &m) {
+        vector<uint64_t> shape;
+        vector<T> cells;
+        get_vector(shape, 2);
+        if (failed) return;
+        get_vector(cells, shape[0] * shape[1]);
+        if (failed) return;
+        m.resize(shape[0], shape[1], T());
+        copy(cells.begin(), cells.end(), m.data());
+    }
+
+    bool ok() const { return !failed; }
+
+    /* the bytes not read yet */
+    const char *rest() const { return pos; }
+    size_t rest_size() const { return end - pos; }
+
+    static const uint64_t ANY = UINT64_MAX;
+
+private:
+    void fail() {
+        failed = true;
+        pos = end;
+    }
+
+    bool take(void *out, size_t n) {
+        if (static_cast<size_t>(end - pos) < n) return false;
+        memcpy(out, pos, n);
+        pos += n;
+        return true;
+    }
+
+    const char *pos;        /* next byte */
+    const char *end;        /* end of the data */
+    bool failed;            /* whether a read failed */
+};
+
+/*
+ * write_cache - write the prepared instance in, read from fileName, to the
+ * cache file cacheName.
+ */
+bool write_cache(const Instance &in, string fileName, string cacheName) {
+    CacheHeaders h;
+    vector<char> head, buf;
+    vector<uint32_t> ints;
+    vector<char> names;
+    unsigned r, p;
+
+    if (!cache_header(fileName, h)) return false;
+    uint32_t counts[11] = {in.num_beds, in.num_rooms, in.num_features,
+                           in.num_departments, in.num_specialisms,
+                           in.num_patients, in.num_days, in.total_days,
+                           in.max_capacity, in.lower_bound, in.feature_words};
+    memcpy(h.counts, counts, sizeof(counts));
+
+    // rooms and patients, field by field; names as lengths and characters.
+    for (r = 0; r < in.num_rooms; r++) {
+        const Rooms &rm = in.rooms[r];
+        uint32_t fields[4] = {static_cast<uint32_t>(rm.name.size()),
+                              rm.capacity, rm.department,
+                              static_cast<uint32_t>(rm.policy)};
+        ints.insert(ints.end(), fields, fields + 4);
+        names.insert(names.end(), rm.name.begin(), rm.name.end());
+    }
+    for (p = 0; p < in.num_patients; p++) {
+        const Patients &pat = in.patients[p];
+        uint32_t fields[8] = {static_cast<uint32_t>(pat.name.size()),
+                              pat.age, static_cast<uint32_t>(pat.gender),
+                              pat.rday, pat.dday, pat.tday, pat.var,
+                              pat.max_admission};
+        ints.insert(ints.end(), fields, fields + 8);
+        names.insert(names.end(), pat.name.begin(), pat.name.end());
+    }
+    put_vector(buf, ints);
+    put_vector(buf, names);
+
+    put_vector(buf, in.aday);
+    put_vector(buf, in.valid_dday);
+    put_vector(buf, in.max_aday);
+    put_vector(buf, in.preferred_cap);
+    put_matrix(buf, in.room_features);
+    put_matrix(buf, in.needed_features);
+    put_matrix(buf, in.preferred_features);
+    put_matrix(buf, in.dept_specialism_level);
+    put_matrix(buf, in.total_patient_room_cost);
+    put_matrix(buf, in.patient_room_availability);
+    put_vector(buf, in.patient_specialism_needed);
+    put_vector(buf, in.candidate_offsets);
+    put_vector(buf, in.candidate_rooms);
+    put_vector(buf, in.department_age_limits);
+    put_vector(buf, in.beds_room_id);
+    put_vector(buf, in.room_first_bed);
+    put_vector(buf, in.overlap_offsets);
+    put_vector(buf, in.overlap_patients);
+    put_vector(buf, in.overlap_days);
+    h.checksum = fnv1a(buf.data(), buf.size());
+    put_array(head, &h, 1);
+
+    ofstream os(cacheName, ios_base::out | ios_base::binary);
+    if (!os.is_open()) {
+        cerr << cacheName << ": cannot open file" << endl;
+        return false;
+    }
+    os.write(head.data(), head.size());
+    os.write(buf.data(), buf.size());
+    return os.good();
+}
+
+/*
+ * increasing_offsets - whether offsets start at 0, never decrease, and end
+ * at the size n of the table they index.
+ */
+bool increasing_offsets(const vector<unsigned> &offsets, size_t n) {
+    size_t i;
+    if (offsets.empty() || offsets[0] != 0 || offsets.back() != n)
+        return false;
+    for (i = 1; i < offsets.size(); i++)
+        if (offsets[i] < offsets[i - 1]) return false;
+    return true;
+}
+
+/*
+ * cache_valid - whether the instance read from a cache is consistent; every
+ * table of the size of its counts, and every stored id in range. A
+ * truncated or stale cache with the right sizes fails here rather than
+ * reading out of bounds later.
+ */
+bool cache_valid(const Instance &in) {
+    const unsigned P = in.num_patients, R = in.num_rooms, D = in.num_days;
+    unsigned r, p, i, beds = 0;
+
+    if (in.feature_words != max(1u, (in.num_features + 63) / 64) ||
+        in.room_features.rows() != R ||
+        in.room_features.cols() != in.feature_words ||
+        in.needed_features.rows() != P ||
+        in.needed_features.cols() != in.feature_words ||
+        in.preferred_features.rows() != P ||
+        in.preferred_features.cols() != in.feature_words ||
+        in.dept_specialism_level.rows() != in.num_departments ||
+        in.dept_specialism_level.cols() != in.num_specialisms ||
+        in.total_patient_room_cost.rows() != P ||
+        in.total_patient_room_cost.cols() != R ||
+        in.patient_room_availability.rows() != P ||
+        in.patient_room_availability.cols() != R ||
+        in.department_age_limits.size() != in.num_departments ||
+        in.beds_room_id.size() != in.num_beds ||
+        !increasing_offsets(in.candidate_offsets, in.candidate_rooms.size()) ||
+        !increasing_offsets(in.overlap_offsets, in.overlap_patients.size()) ||
+        in.overlap_days.size() != in.overlap_patients.size())
+        return false;
+
+    for (r = 0; r < R; r++) {
+        const Rooms &room = in.rooms[r];
+        if (room.department >= in.num_departments ||
+            room.policy > TOGETHER || room.capacity > in.max_capacity ||
+            in.room_first_bed[r] != beds)
+            return false;
+        beds += room.capacity;
+    }
+    if (beds != in.num_beds) return false;
+    for (i = 0; i < in.num_beds; i++)
+        if (in.beds_room_id[i] >= R) return false;
+    for (i = 0; i < in.num_departments * in.num_specialisms; i++)
+        if (in.dept_specialism_level.data()[i] > NONE) return false;
+
+    for (p = 0; p < P; p++)
+        if (in.patients[p].gender > FEMALE || in.valid_dday[p] > D ||
+            in.patient_specialism_needed[p] >= in.num_specialisms)
+            return false;
+    for (i = 0; i < in.candidate_rooms.size(); i++)
+        if (in.candidate_rooms[i] >= R) return false;
+    for (i = 0; i < in.overlap_patients.size(); i++)
+        if (in.overlap_patients[i] >= P) return false;
+    return true;
+}
+
+/*
+ * read_cache - load the prepared instance in from the cache file cacheName
+ * of the instance file fileName. Returns false, with in unusable, if there is
+ * no cache, or it is stale, of another version, corrupt, or malformed.
+ */
+bool read_cache(Instance &in, string fileName, string cacheName) {
+    CacheHeaders want;
+    vector<CacheHeaders> h;
+    vector<uint32_t> ints;
+    vector<char> names;
+    unsigned r, p, n = 0;
+    size_t at = 0;
+
+    ifstream is(cacheName, ios_base::in | ios_base::binary);
+    if (!is.is_open() || !cache_header(fileName, want)) return false;
+    is.seekg(0, ios_base::end);
+    vector<char> data(static_cast<size_t>(is.tellg()));
+    is.seekg(0, ios_base::beg);
+    is.read(data.data(), data.size());
+    if (!is) return false;
+    is.close();
+
+    CacheReader cr(data.data(), data.size());
+    cr.get_vector(h, 1);
+    if (!cr.ok() || memcmp(h[0].magic, want.magic, sizeof(want.magic)) != 0 ||
+        h[0].version != want.version || h[0].byte_order != want.byte_order ||
+        h[0].source_size != want.source_size ||
+        h[0].source_time != want.source_time ||
+        memcmp(h[0].weights, want.weights, sizeof(want.weights)) != 0 ||
+        h[0].checksum != fnv1a(cr.rest(), cr.rest_size()))
+        return false;
+    const uint32_t *c = h[0].counts;
+    in.num_beds = c[0];
+    in.num_rooms = c[1];
+    in.num_features = c[2];
+    in.num_departments = c[3];
+    in.num_specialisms = c[4];
+    in.num_patients = c[5];
+    in.num_days = c[6];
+    in.total_days = c[7];
+    in.max_capacity = c[8];
+    in.lower_bound = c[9];
+    in.feature_words = c[10];
+
+    cr.get_vector(ints, 4 * in.num_rooms + 8 * in.num_patients);
+    cr.get_vector(names);
+    if (!cr.ok()) return false;
+    in.rooms.resize(in.num_rooms);
+    in.patients.resize(in.num_patients);
+    for (r = 0; r < in.num_rooms; r++, n += 4) {
+        Rooms &rm = in.rooms[r];
+        if (names.size() - at < ints[n]) return false;
+        rm.name.assign(&names[at], ints[n]);
+        at += ints[n];
+        rm.capacity = ints[n + 1];
+        rm.department = ints[n + 2];
+        rm.policy = static_cast<GenderPolicy>(ints[n + 3]);
+    }
+    for (p = 0; p < in.num_patients; p++, n += 8) {
+        Patients &pat = in.patients[p];
+        if (names.size() - at < ints[n]) return false;
+        pat.name.assign(&names[at], ints[n]);
+        at += ints[n];
+        pat.age = ints[n + 1];
+        pat.gender = static_cast<Gender>(ints[n + 2]);
+        pat.rday = ints[n + 3];
+        pat.dday = ints[n + 4];
+        pat.tday = ints[n + 5];
+        pat.var = ints[n + 6];
+        pat.max_admission = ints[n + 7];
+    }
+
+    cr.get_vector(in.aday, in.num_patients);
+    cr.get_vector(in.valid_dday, in.num_patients);
+    cr.get_vector(in.max_aday, in.num_patients);
+    cr.get_vector(in.preferred_cap, in.num_patients);
+    cr.get_matrix(in.room_features);
+    cr.get_matrix(in.needed_features);
+    cr.get_matrix(in.preferred_features);
+    cr.get_matrix(in.dept_specialism_level);
+    cr.get_matrix(in.total_patient_room_cost);
+    cr.get_matrix(in.patient_room_availability);
+    cr.get_vector(in.patient_specialism_needed, in.num_patients);
+    cr.get_vector(in.candidate_offsets, in.num_patients + 1);
+    cr.get_vector(in.candidate_rooms);
+    cr.get_vector(in.department_age_limits);
+    cr.get_vector(in.beds_room_id);
+    cr.get_vector(in.room_first_bed, in.num_rooms);
+    cr.get_vector(in.overlap_offsets, in.num_patients + 1);
+    cr.get_vector(in.overlap_patients);
+    cr.get_vector(in.overlap_days);
+    if (!cr.ok() || !cache_valid(in)) return false;
+    compute_shape(in);
+    return true;
+}
+
+/*
+ * reset_schedule - reset data structures for another round of calculation.
+ */
+void reset_schedule(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned p, r, d;
+    for (p = 0; p < in.num_patients; p++) {
+        sv.tags[p] = UNREGISTERED;
+        sv.assignments[p].ra = NO_ROOM;
+    }
+
+    // a restart schedules from day 0 again, so every bed is free.
+    for (r = 0; r < in.num_rooms; r++) {
+        for (d = 0; d < in.num_days; d++) {
+            sv.beds[r][d] = in.rooms[r].capacity;
+        }
+    }
+    sv.bed_trees.build(sv.beds, in.num_days);
+    sv.room_genders.fill(0);
+    sv.gender_sums.fill(0);
+    sv.gender_cost = 0;
+    sv.at_risk.fill(0);
+    sv.risk_cost = 0;
+    memset(sv.objectives.parts, 0, sizeof(sv.objectives.parts));
+}
+
+
+/*
+ * set_deadline - start the run of a solver at start; its searches stop
+ * TIME_LIMIT_MS later, if there is a time limit.
+ */
+void set_deadline(Solver &sv, chrono::steady_clock::time_point start) {
+    sv.start = start;
+    if (TIME_LIMIT_MS > 0)
+        sv.deadline = start + chrono::milliseconds(TIME_LIMIT_MS);
+    else
+        sv.deadline = chrono::steady_clock::time_point::max();
+}
+
+/*
+ * init_solver - size the state of a solver for the loaded instance, with all
+ * patients unassigned, and seed its random number generator.
+ */
+void init_solver(Solver &sv, const Instance &in, uint64_t seed) {
+    unsigned p, size;
+    Assignments as;
+
+    sv.inst = &in;
+    sv.tags.assign(in.num_patients, UNREGISTERED);
+    sv.beds.resize(in.num_rooms, in.num_days, 0);
+    sv.beds_tempo.resize(in.num_rooms, in.num_days, 0);
+    sv.room_genders.resize(2 * in.num_rooms, in.num_days, 0);
+    sv.gender_sums.resize(4 * in.num_rooms, in.num_days + 1, 0);
+    sv.at_risk.resize(in.num_rooms, in.num_days, 0);
+    sv.assignments.clear();
+    for (p = 0; p < in.num_patients; p++) {
+        as.aday = in.aday[p];
+        as.tday = NO_DAY;
+        as.dday = in.valid_dday[p];
+        as.ra = NO_ROOM;
+        as.rb = NO_ROOM;
+        as.cost = 1000000;
+        sv.assignments.push_back(as);
+    }
+    sv.tabu_until.resize(in.num_patients, in.num_rooms + in.num_days, 0);
+    for (size = 64; size < 8 * TABU_TENURE; size *= 2);
+    sv.swap_tabu.assign(size, SwapTabus());
+    sv.tabu_clock = 0;
+    sv.total_cost = 0;
+    sv.rng.seed(seed);
+    sv.today = 0;
+    sv.focus.clear();
+    sv.window_lo = 0;
+    sv.window_hi = in.num_days;
+    sv.stop = NO_STOP;
+    sv.out = &outFile;
+    sv.streamed_cost = INT_MAX;
+    set_deadline(sv, chrono::steady_clock::now());
+    reset_schedule(sv);
+}
+
+/*
+ * update_tempo_room_capacity - copy data for restarting.
+ */
+void update_tempo_room_capacity(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned r, d;
+    for (r = 0; r < in.num_rooms; r++) {
+        for (d = 0; d < in.num_days; d++) {
+            sv.beds_tempo[r][d] = sv.beds[r][d];
+        }
+    }
+    sv.bed_trees_tempo = sv.bed_trees;
+}
+
+/*
+ * update_room_capacity - update current room capacity.
+ */
+void update_room_capacity(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned r, d;
+    for (r = 0; r < in.num_rooms; r++) {
+        for (d = 0; d < in.num_days; d++) {
+            sv.beds[r][d] = sv.beds_tempo[r][d];
+        }
+    }
+    sv.bed_trees = sv.bed_trees_tempo;
+}
+
+/*
+ * arrange_patients - schedule patient admission.
+ */
+bool arrange_patients(Solver &sv, unsigned d) {
+    const Instance &in = *sv.inst;
+    unsigned p, a, i, aday, valid_dday, ran, room;
+    bool found;
+    for (p = 0; p < in.num_patients; p++) {
+        const unsigned short *cand = &in.candidate_rooms[0] +
+                                     in.candidate_offsets[p];
+        a = in.candidate_offsets[p + 1] - in.candidate_offsets[p];
+        if (d == in.aday[p]) sv.tags[p] = ADMITTED;
+        else if (d == in.patients[p].rday) sv.tags[p] = REGISTERED;
+        else if (d == in.valid_dday[p]) sv.tags[p] = DISCHARGED;
+
+        // For all in-hospital patients, search for available beds for them
+        // and update corresponding room status.
+        if ((sv.tags[p] == ADMITTED && d == in.aday[p]) ||
+            sv.tags[p] == REGISTERED &&
+            in.aday[p] != in.patients[p].rday) {
+            aday = in.aday[p];
+            valid_dday = in.valid_dday[p];
+
+            // search for available beds among the candidate rooms, a random
+            // one first, then from the most expensive one down.
+            found = false;
+            if (a > 0) {
+                ran = sv.rng.below(a);
+                for (;;) {
+                    room = cand[ran];
+                    if (sv.bed_trees_tempo.min_free(room, aday,
+                                                    valid_dday) >= 1) {
+                        found = true;
+                        break;
+                    }
+                    if (a == 0) break;
+                    ran = --a;
+                }
+            }
+            if (!found) {
+                // handle failed scheduling
+                *sv.out << "Failed p = " << p << endl;
+                COUNT(FAILED_PLACEMENTS);
+                return false;
+            }
+
+            // update room status.
+            sv.assignments[p].ra = room;
+            for (i = aday; i < valid_dday; i++) sv.beds_tempo[room][i]--;
+            sv.bed_trees_tempo.add(room, aday, valid_dday, -1);
+        }
+    }
+    return true;
+}
+
+/*
+ * generate_ini_solution - generate initial solution as the starting point.
+ */
+unsigned generate_ini_solution(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned r, n, da, m, p, t, i, room;
+    for (n = 0; n < MAX_RESTARTS; n++) {
+        t = 1;
+        if (n > 0) COUNT(RESTARTS);
+        if (chrono::steady_clock::now() >= sv.deadline) break;
+
+        // reset data structure for the current new scheduling
+        reset_schedule(sv);
+
+        // schedule patient-bed assignment per day
+        for (da = 0; da < in.num_days && t == 1; da++) {
+            update_tempo_room_capacity(sv);
+
+            // if all patients assigned!
+            if (arrange_patients(sv, da)) {
+                for (p = 0; p < in.num_patients; p++) {
+                    room = sv.assignments[p].ra;
+                    if (sv.tags[p] == REGISTERED &&
+                        in.aday[p] != in.patients[p].rday &&
+                        room != NO_ROOM && in.aday[p] < in.valid_dday[p]) {
+                        for (i = in.aday[p]; i < in.valid_dday[p]; i++)
+                            sv.beds_tempo[room][i]++;
+                        sv.bed_trees_tempo.add(room, in.aday[p],
+                                               in.valid_dday[p], 1);
+                    }
+                }
+
+                // update room cap for this arrangement and move to next day
+                update_room_capacity(sv);
+            } else {
+                // else, if someone hasn't been assigned a bed, restart this day
+                t = 0;
+            }
+        }
+
+        if (t == 1) {
+            *sv.out << "successfully generated an initial solution!" << endl;
+            break;
+        }/* found the initial solution! */
+    }
+    return n;
+}
+
+/*
+ * room_on_day - the room of an assignment on day d, NO_ROOM if not in stay.
+ */
+unsigned room_on_day(const Assignments &as, unsigned d) {
+    if (d < as.aday || d >= as.dday) return NO_ROOM;
+    if (as.tday != NO_DAY && d >= as.tday) return as.rb;
+    return as.ra;
+}
+
+/*
+ * same_assignment - whether two assignments give the same rooms and days.
+ */
+bool same_assignment(const Assignments &a, const Assignments &b) {
+    return a.aday == b.aday && a.tday == b.tday && a.dday == b.dday &&
+           a.ra == b.ra && (a.tday == NO_DAY || a.rb == b.rb);
+}
+
+/*
+ * is_swap_move - whether a move type reschedules two patients.
+ */
+bool is_swap_move(MoveType type) {
+    return type == SWAP || type == PARTIAL_SWAP;
+}
+
+/*
+ * assignment_cost - penalty cost of assignment as for patient p. Room costs
+ * are charged per day of stay, plus the transfer and the admission delay.
+ */
+unsigned assignment_cost(const Instance &in, unsigned p,
+                         const Assignments &as) {
+    unsigned cost;
+    if (as.tday == NO_DAY) {
+        cost = in.total_patient_room_cost[p][as.ra] * (as.dday - as.aday);
+    } else {
+        cost = in.total_patient_room_cost[p][as.ra] * (as.tday - as.aday) +
+               in.total_patient_room_cost[p][as.rb] * (as.dday - as.tday) +
+               TRANSFER_WEIGHT;
+    }
+    return cost + DELAY_WEIGHT * (as.aday - in.aday[p]);
+}
+
+/*
+ * load_assignments - complete the assignments of the generated schedule,
+ * whose rooms arrange_patients() set. Returns false if some patient has no
+ * room.
+ */
+bool load_assignments(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned p;
+    for (p = 0; p < in.num_patients; p++) {
+        Assignments *as = &sv.assignments[p];
+        as->aday = in.aday[p];
+        as->dday = in.valid_dday[p];
+        as->tday = NO_DAY;
+        as->rb = NO_ROOM;
+        if (as->aday >= as->dday)
+            as->ra = 0;     /* empty stay; no bed needed */
+        if (as->ra == NO_ROOM) return false;
+    }
+    return true;
+}
+
+/*
+ * calculate_cost - calculate penalty cost for the assignments, plus the
+ * SAME_GENDER penalty and the overcrowding risk of the rooms kept up to date
+ * by the bed changes.
+ */
+bool calculate_cost(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned p;
+    sv.total_cost = sv.gender_cost + sv.risk_cost;
+    for (p = 0; p < in.num_patients; p++) {
+        sv.assignments[p].cost = assignment_cost(in, p, sv.assignments[p]);
+        sv.total_cost += sv.assignments[p].cost;
+    }
+    return true;
+}
+
+/*
+ * mixed_cost - SAME_GENDER penalty of a room-day with m male and f female
+ * patients; GENDER_WEIGHT for each patient of the minority gender.
+ */
+inline unsigned mixed_cost(unsigned m, unsigned f) {
+    return GENDER_WEIGHT * min(m, f);
+}
+
+/*
+ * gender_step - change of the SAME_GENDER penalty of a room-day with m male
+ * and f female patients when one more patient of gender k % 2 enters it
+ * (k < 2), or one leaves it (k >= 2); the step kinds of gender_sums.
+ */
+inline int gender_step(unsigned m, unsigned f, unsigned k) {
+    unsigned &n = k % 2 == MALE ? m : f;
+    unsigned before = mixed_cost(m, f);
+    if (k >= 2 && n == 0) return 0;
+    n = k < 2 ? n + 1 : n - 1;
+    return static_cast<int>(mixed_cost(m, f)) - static_cast<int>(before);
+}
+
+/*
+ * count_gender - add step patients of gender g to room r on day d, with the
+ * change of the SAME_GENDER penalty, and of the prefix sums of the later
+ * days of a SAME_GENDER room.
+ */
+void count_gender(Solver &sv, unsigned r, unsigned d, Gender g, int step) {
+    const unsigned D = sv.inst->num_days;
+    unsigned short &m = sv.room_genders[2 * r + MALE][d];
+    unsigned short &f = sv.room_genders[2 * r + FEMALE][d];
+    bool same = sv.inst->rooms[r].policy == SAME_GENDER;
+    unsigned k, e, before = same ? mixed_cost(m, f) : 0;
+    int old_steps[4];
+    if (same)
+        for (k = 0; k < 4; k++) old_steps[k] = gender_step(m, f, k);
+    (g == MALE ? m : f) += step;
+    if (!same) return;
+    sv.gender_cost += mixed_cost(m, f) - before;
+    sv.objectives.parts[GENDER_COST] +=
+        static_cast<int64_t>(mixed_cost(m, f)) - before;
+    for (k = 0; k < 4; k++) {
+        int diff = gender_step(m, f, k) - old_steps[k];
+        if (diff == 0) continue;
+        int *sums = sv.gender_sums[4 * r + k];
+        for (e = d + 1; e <= D; e++) sums[e] += diff;
+    }
+}
+
+/*
+ * Overcrowding risk - a patient with variability var may stay up to var days
+ * past its discharge, in its last room. On each room-day the patients who
+ * may overstay into it are counted in at_risk; those beyond the free beds
+ * would overflow the room, and each costs OVERCROWD_RISK_WEIGHT. The free
+ * beds and the counts change together through change_cell(), which keeps
+ * the risk cost up to date.
+ */
+inline unsigned overflow_cost(unsigned risk, unsigned free) {
+    return OVERCROWD_RISK_WEIGHT * (risk > free ? risk - free : 0);
+}
+
+/*
+ * change_cell - add dfree free beds and drisk patients at risk to room r on
+ * day d, with the change of the overcrowding risk.
+ */
+void change_cell(Solver &sv, unsigned r, unsigned d, int dfree, int drisk) {
+    unsigned short &free = sv.beds[r][d];
+    unsigned short &risk = sv.at_risk[r][d];
+    unsigned before = overflow_cost(risk, free);
+    free += dfree;
+    risk += drisk;
+    sv.risk_cost += overflow_cost(risk, free) - before;
+    sv.objectives.parts[OVERCROWD_COST] +=
+        static_cast<int64_t>(overflow_cost(risk, free)) - before;
+}
+
+/*
+ * risk_days - the days [from, to) on which patient p may overstay assignment
+ * as, in room r; false if none.
+ */
+bool risk_days(const Instance &in, unsigned p, const Assignments &as,
+               unsigned &r, unsigned &from, unsigned &to) {
+    unsigned var = in.patients[p].var;
+    if (var == 0 || as.ra == NO_ROOM || as.aday >= as.dday) return false;
+    r = as.tday == NO_DAY ? as.ra : as.rb;
+    from = as.dday;
+    to = min(as.dday + var, in.num_days);
+    return from < to;
+}
+
+/*
+ * add_risk - count patient p at risk (step 1) or not (step -1) on the days it
+ * may overstay assignment as.
+ */
+void add_risk(Solver &sv, unsigned p, const Assignments &as, int step) {
+    unsigned r, d, from, to;
+    if (!risk_days(*sv.inst, p, as, r, from, to)) return;
+    for (d = from; d < to; d++) change_cell(sv, r, d, 0, step);
+}
+
+/*
+ * risk_room - the room patient p may overstay assignment as into on day d,
+ * NO_ROOM if none.
+ */
+unsigned risk_room(const Instance &in, unsigned p, const Assignments &as,
+                   unsigned d) {
+    unsigned r, from, to;
+    if (!risk_days(in, p, as, r, from, to) || d < from || d >= to)
+        return NO_ROOM;
+    return r;
+}
+
+/*
+ * risk_delta - change of the overcrowding risk by a move. Day by day, only
+ * the rooms whose free beds or patients at risk the moved patients change
+ * are evaluated, so a move costs O(1) per day of the moved stays and their
+ * overstay days.
+ */
+int risk_delta(const Solver &sv, const Moves &mv) {
+    const Instance &in = *sv.inst;
+    unsigned i, j, k, n = is_swap_move(mv.type) ? 2 : 1;
+    unsigned d, from = UINT_MAX, to = 0, r, nr;
+    unsigned pts[2] = {mv.p1, mv.p2};
+    const Assignments *cur[2] = {&sv.assignments[mv.p1],
+                                 &sv.assignments[mv.p2]};
+    const Assignments *nas[2] = {&mv.a1, &mv.a2};
+    unsigned rooms[8];
+    int dfree[8], drisk[8], delta = 0;
+
+    if (OVERCROWD_RISK_WEIGHT == 0) return 0;
+    for (i = 0; i < n; i++) {
+        from = min(from, min(cur[i]->aday, nas[i]->aday));
+        to = max(to, max(cur[i]->dday, nas[i]->dday) +
+                     in.patients[pts[i]].var);
+    }
+    to = min(to, in.num_days);
+
+    for (d = from; d < to; d++) {
+        nr = 0;
+        for (i = 0; i < n; i++) {
+            // leaving and entering rooms, then leaving and entering risk.
+            unsigned moved[4] = {room_on_day(*cur[i], d),
+                                 room_on_day(*nas[i], d),
+                                 risk_room(in, pts[i], *cur[i], d),
+                                 risk_room(in, pts[i], *nas[i], d)};
+            int step[4] = {1, -1, -1, 1};
+            for (j = 0; j < 4; j++) {
+                r = moved[j];
+                if (r == NO_ROOM || r == moved[j ^ 1]) continue;
+                for (k = 0; k < nr && rooms[k] != r; k++);
+                if (k == nr) {
+                    rooms[nr] = r;
+                    dfree[nr] = drisk[nr] = 0;
+                    nr++;
+                }
+                if (j < 2) dfree[k] += step[j];
+                else drisk[k] += step[j];
+            }
+        }
+        for (k = 0; k < nr; k++) {
+            unsigned free = sv.beds[rooms[k]][d];
+            unsigned risk = sv.at_risk[rooms[k]][d];
+            delta += static_cast<int>(overflow_cost(risk + drisk[k],
+                                                    free + dfree[k])) -
+                     static_cast<int>(overflow_cost(risk, free));
+        }
+    }
+    return delta;
+}
+
+/*
+ * risk_gain - a bound on the overcrowding risk patient p can save by moving;
+ * it frees one bed a day of its stay and leaves the risk of its overstay
+ * days, each worth at most OVERCROWD_RISK_WEIGHT.
+ */
+int risk_gain(const Solver &sv, unsigned p) {
+    const Assignments &as = sv.assignments[p];
+    unsigned r, from, to, days = as.dday - as.aday;
+    if (risk_days(*sv.inst, p, as, r, from, to)) days += to - from;
+    return static_cast<int>(OVERCROWD_RISK_WEIGHT * days);
+}
+
+/*
+ * gender_sum - change of the SAME_GENDER penalty of room r if one patient of
+ * gender g enters it (step 1), or leaves it (step -1), on each day of
+ * [from, to); two prefix sums. Zero for the other rooms.
+ */
+inline int gender_sum(const Solver &sv, unsigned r, Gender g, int step,
+                      unsigned from, unsigned to) {
+    if (r == NO_ROOM || from >= to) return 0;
+    const int *sums = sv.gender_sums[4 * r + (step < 0 ? 2 : 0) + g];
+    return sums[to] - sums[from];
+}
+
+/*
+ * stay_pieces - the rooms of assignment as, with their days [from, to); two
+ * with a transfer, else one. Returns the number.
+ */
+inline unsigned stay_pieces(const Assignments &as, unsigned rooms[2],
+                            unsigned from[2], unsigned to[2]) {
+    rooms[0] = as.ra;
+    from[0] = as.aday;
+    to[0] = as.tday == NO_DAY ? as.dday : as.tday;
+    if (as.tday == NO_DAY) return 1;
+    rooms[1] = as.rb;
+    from[1] = as.tday;
+    to[1] = as.dday;
+    return 2;
+}
+
+/*
+ * stay_gender - change of the SAME_GENDER penalty if a patient of gender g
+ * leaves (step -1) or enters (step 1) the rooms of stay as, on the days stay
+ * other does not have it in the same room; in O(1).
+ */
+int stay_gender(const Solver &sv, Gender g, int step, const Assignments &as,
+                const Assignments &other) {
+    unsigned rooms[2], from[2], to[2], orooms[2], ofrom[2], oto[2], i, j, n, on;
+    int delta = 0;
+    n = stay_pieces(as, rooms, from, to);
+    on = stay_pieces(other, orooms, ofrom, oto);
+    for (i = 0; i < n; i++) {
+        delta += gender_sum(sv, rooms[i], g, step, from[i], to[i]);
+        for (j = 0; j < on; j++)
+            if (orooms[j] == rooms[i])
+                delta -= gender_sum(sv, rooms[i], g, step,
+                                    max(from[i], ofrom[j]), min(to[i], oto[j]));
+    }
+    return delta;
+}
+
+/*
+ * swap_gender_delta - change of the SAME_GENDER penalty by a swap move. The
+ * two patients may meet in a room-day, so it is evaluated day by day; only
+ * the rooms a moved patient leaves or enters change, and each needs its two
+ * counts, so a swap costs O(1) per day of the moved stays. Swaps that touch
+ * no SAME_GENDER room cost nothing.
+ */
+int swap_gender_delta(const Solver &sv, const Moves &mv) {
+    const Instance &in = *sv.inst;
+    unsigned i, j, k, n = 2;
+    unsigned d, from = UINT_MAX, to = 0, r, nr;
+    unsigned pts[2] = {mv.p1, mv.p2};
+    const Assignments *cur[2] = {&sv.assignments[mv.p1],
+                                 &sv.assignments[mv.p2]};
+    const Assignments *nas[2] = {&mv.a1, &mv.a2};
+    unsigned rooms[4];
+    int dm[4], df[4], delta = 0;
+    bool any = false;
+
+    for (i = 0; i < n; i++) {
+        const Assignments *as[2] = {cur[i], nas[i]};
+        for (j = 0; j < 2; j++) {
+            if (in.rooms[as[j]->ra].policy == SAME_GENDER ||
+                (as[j]->tday != NO_DAY &&
+                 in.rooms[as[j]->rb].policy == SAME_GENDER))
+                any = true;
+            from = min(from, as[j]->aday);
+            to = max(to, as[j]->dday);
+        }
+    }
+    if (!any) return 0;
+
+    for (d = from; d < to; d++) {
+        nr = 0;
+        for (i = 0; i < n; i++) {
+            unsigned leave = room_on_day(*cur[i], d);
+            unsigned enter = room_on_day(*nas[i], d);
+            int step[2] = {-1, 1};
+            unsigned moved[2] = {leave, enter};
+            if (leave == enter) continue;
+            for (j = 0; j < 2; j++) {
+                r = moved[j];
+                if (r == NO_ROOM || in.rooms[r].policy != SAME_GENDER)
+                    continue;
+                for (k = 0; k < nr && rooms[k] != r; k++);
+                if (k == nr) {
+                    rooms[nr] = r;
+                    dm[nr] = df[nr] = 0;
+                    nr++;
+                }
+                if (in.patients[pts[i]].gender == MALE) dm[k] += step[j];
+                else df[k] += step[j];
+            }
+        }
+        for (k = 0; k < nr; k++) {
+            unsigned m = sv.room_genders[2 * rooms[k] + MALE][d];
+            unsigned f = sv.room_genders[2 * rooms[k] + FEMALE][d];
+            delta += static_cast<int>(mixed_cost(m + dm[k], f + df[k])) -
+                     static_cast<int>(mixed_cost(m, f));
+        }
+    }
+    return delta;
+}
+
+/*
+ * gender_delta - change of the SAME_GENDER penalty by a move. A patient
+ * moving alone changes each room-day it leaves or enters by one patient, so
+ * the move is the steps of its old stay and its new one, in O(1).
+ */
+int gender_delta(const Solver &sv, const Moves &mv) {
+    if (is_swap_move(mv.type)) return swap_gender_delta(sv, mv);
+    const Assignments &cur = sv.assignments[mv.p1];
+    Gender g = sv.inst->patients[mv.p1].gender;
+    return stay_gender(sv, g, -1, cur, mv.a1) +
+           stay_gender(sv, g, 1, mv.a1, cur);
+}
+
+/*
+ * leave_gain - change of the SAME_GENDER penalty if patient p left its beds;
+ * never positive. With it, leave_gain plus the change of the patient's own
+ * cost bounds the delta of any single-patient move from below.
+ */
+int leave_gain(const Solver &sv, unsigned p) {
+    Gender g = sv.inst->patients[p].gender;
+    unsigned rooms[2], from[2], to[2], i, n;
+    int gain = 0;
+    n = stay_pieces(sv.assignments[p], rooms, from, to);
+    for (i = 0; i < n; i++)
+        gain += gender_sum(sv, rooms[i], g, -1, from[i], to[i]);
+    return gain;
+}
+
+/*
+ * add_assignment_parts - add the cost of assignment as of patient p by
+ * component to ob, times sign (1 to add it, -1 to take it out); that is,
+ * assignment_cost() split up. The SAME_GENDER penalty of the rooms is added
+ * by count_gender().
+ */
+void add_assignment_parts(const Instance &in, unsigned p,
+                          const Assignments &as, int sign, Objectives &ob) {
+    unsigned k, split, parts[NUM_COST_PARTS];
+    if (as.ra == NO_ROOM) return;
+    split = as.tday == NO_DAY ? as.dday : as.tday;
+    room_cost_parts(in, p, as.ra, parts);
+    for (k = PROPERTY_COST; k <= GENDER_COST; k++)
+        ob.parts[k] += static_cast<int64_t>(sign) * parts[k] *
+                       (split - as.aday);
+    if (as.tday != NO_DAY) {
+        room_cost_parts(in, p, as.rb, parts);
+        for (k = PROPERTY_COST; k <= GENDER_COST; k++)
+            ob.parts[k] += static_cast<int64_t>(sign) * parts[k] *
+                           (as.dday - as.tday);
+        ob.parts[TRANSFER_COST] += sign * static_cast<int64_t>(
+                                       TRANSFER_WEIGHT);
+    }
+    ob.parts[DELAY_COST] += static_cast<int64_t>(sign) * DELAY_WEIGHT *
+                            (as.aday - in.aday[p]);
+}
+
+/*
+ * objective_total - the total cost of the components of ob.
+ */
+int64_t objective_total(const Objectives &ob) {
+    int64_t total = 0;
+    unsigned k;
+    for (k = 0; k < NUM_COST_PARTS; k++) total += ob.parts[k];
+    return total;
+}
+
+/*
+ * evaluate_objectives - recompute the cost of the assignments of sv by
+ * component from scratch, without the running counts of the solver.
+ */
+void evaluate_objectives(const Solver &sv, Objectives &ob) {
+    const Instance &in = *sv.inst;
+    unsigned p, r, d;
+    Matrix<unsigned short> genders;
+
+    Matrix<unsigned> used, risk;
+    unsigned rr, from, to;
+
+    memset(ob.parts, 0, sizeof(ob.parts));
+    genders.resize(2 * in.num_rooms, in.num_days, 0);
+    used.resize(in.num_rooms, in.num_days, 0);
+    risk.resize(in.num_rooms, in.num_days, 0);
+    for (p = 0; p < in.num_patients; p++) {
+        const Assignments &as = sv.assignments[p];
+        add_assignment_parts(in, p, as, 1, ob);
+        if (as.ra == NO_ROOM) continue;
+        for (d = as.aday; d < as.dday; d++) {
+            genders[2 * room_on_day(as, d) + in.patients[p].gender][d]++;
+            used[room_on_day(as, d)][d]++;
+        }
+        if (risk_days(in, p, as, rr, from, to))
+            for (d = from; d < to; d++) risk[rr][d]++;
+    }
+    for (r = 0; r < in.num_rooms; r++) {
+        for (d = 0; d < in.num_days; d++) {
+            ob.parts[OVERCROWD_COST] += overflow_cost(
+                risk[r][d], in.rooms[r].capacity - used[r][d]);
+            if (in.rooms[r].policy == SAME_GENDER)
+                ob.parts[GENDER_COST] += mixed_cost(
+                    genders[2 * r + MALE][d], genders[2 * r + FEMALE][d]);
+        }
+    }
+}
+
+/* Names of the cost components, for the output. */
+const char *const COST_PART_NAMES[] = {
+    "Property", "Preference", "Specialism", "Gender", "Transfer", "Delay",
+    "Overcrowd Risk"
+};
+
+/*
+ * verify_objectives - check the running cost by component of sv, and the
+ * running total cost of a search, against a recomputation from scratch.
+ * Reports the first drift found; returns false if there is one.
+ */
+bool verify_objectives(const Solver &sv, int64_t running) {
+    Objectives full;
+    unsigned k;
+    evaluate_objectives(sv, full);
+    for (k = 0; k < NUM_COST_PARTS; k++) {
+        if (full.parts[k] == sv.objectives.parts[k]) continue;
+        cerr << "Cost drift: " << COST_PART_NAMES[k] << " running "
+             << sv.objectives.parts[k] << ", recomputed " << full.parts[k]
+             << endl;
+        return false;
+    }
+    if (objective_total(full) != running) {
+        cerr << "Cost drift: total running " << running << ", recomputed "
+             << objective_total(full) << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * beds_free - whether room r has a free bed for one more patient on every day
+ * of [from, to). The beds the released assignments hold in r count as free,
+ * and the bed the claimed assignment takes in r counts as taken. The range is
+ * cut where those beds start or end, and each piece is one range query. A
+ * move releases at most MAX_RELEASED assignments.
+ */
+const unsigned MAX_RELEASED = 2;
+
+bool beds_free(const Solver &sv, unsigned r, unsigned from, unsigned to,
+               const Assignments *released[], unsigned num_released,
+               const Assignments *claimed) {
+    unsigned cuts[2 + 3 * (MAX_RELEASED + 1)], days[3], n = 0, i, j, k;
+    int need;
+
+    if (from >= to) return true;
+    if (num_released > MAX_RELEASED) num_released = MAX_RELEASED;
+    cuts[n++] = from;
+    cuts[n++] = to;
+    for (i = 0; i <= num_released; i++) {
+        const Assignments *as = i < num_released ? released[i] : claimed;
+        if (as == NULL || (as->ra != r && (as->tday == NO_DAY || as->rb != r)))
+            continue;
+        days[0] = as->aday;
+        days[1] = as->tday;
+        days[2] = as->dday;
+        for (j = 0; j < 3; j++)
+            if (days[j] > from && days[j] < to) cuts[n++] = days[j];
+    }
+    // a few cuts; insertion sort them, dropping the repeats.
+    for (i = 1, k = 1; i < n; i++) {
+        unsigned day = cuts[i];
+        for (j = k; j > 0 && cuts[j - 1] > day; j--) cuts[j] = cuts[j - 1];
+        if (j > 0 && cuts[j - 1] == day) {
+            // a repeat; shift the greater cuts back.
+            for (; j < k; j++) cuts[j] = cuts[j + 1];
+            continue;
+        }
+        cuts[j] = day;
+        k++;
+    }
+    n = k;
+
+    for (k = 0; k + 1 < n; k++) {
+        need = 1;
+        for (i = 0; i < num_released; i++)
+            if (room_on_day(*released[i], cuts[k]) == r) need--;
+        if (claimed != NULL && room_on_day(*claimed, cuts[k]) == r) need++;
+        if (need > 0 && sv.bed_trees.min_free(r, cuts[k], cuts[k + 1]) < need)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * move_feasible - check the room availability of the new assignments, and
+ * that a bed is free on every day of the new stays once the moved patients
+ * have released their current beds.
+ */
+bool move_feasible(const Solver &sv, const Moves &mv) {
+    const Instance &in = *sv.inst;
+    unsigned i, split, n = is_swap_move(mv.type) ? 2 : 1;
+    unsigned pts[2] = {mv.p1, mv.p2};
+    const Assignments *nas[2] = {&mv.a1, &mv.a2};
+    const Assignments *cur[2] = {&sv.assignments[mv.p1],
+                                 &sv.assignments[mv.p2]};
+
+    for (i = 0; i < n; i++) {
+        const Assignments &as = *nas[i];
+        if (!in.patient_room_availability[pts[i]][as.ra] ||
+            (as.tday != NO_DAY && !in.patient_room_availability[pts[i]][as.rb]))
+            return false;
+    }
+    for (i = 0; i < n; i++) {
+        const Assignments &as = *nas[i];
+        // the second patient competes with the first one's new beds.
+        const Assignments *claimed = i == 1 ? &mv.a1 : NULL;
+        split = as.tday == NO_DAY ? as.dday : as.tday;
+        if (!beds_free(sv, as.ra, as.aday, split, cur, n, claimed))
+            return false;
+        if (as.tday != NO_DAY &&
+            !beds_free(sv, as.rb, as.tday, as.dday, cur, n, claimed))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * remove_patient - release the beds of the current assignment of patient p.
+ */
+void remove_patient(Solver &sv, unsigned p) {
+    unsigned d, r;
+    const Assignments &as = sv.assignments[p];
+    Gender g = sv.inst->patients[p].gender;
+    add_assignment_parts(*sv.inst, p, as, -1, sv.objectives);
+    add_risk(sv, p, as, -1);
+    for (d = as.aday; d < as.dday; d++) {
+        r = room_on_day(as, d);
+        change_cell(sv, r, d, 1, 0);
+        count_gender(sv, r, d, g, -1);
+    }
+    if (as.tday == NO_DAY) {
+        sv.bed_trees.add(as.ra, as.aday, as.dday, 1);
+    } else {
+        sv.bed_trees.add(as.ra, as.aday, as.tday, 1);
+        sv.bed_trees.add(as.rb, as.tday, as.dday, 1);
+    }
+}
+
+/*
+ * place_patient - make as the assignment of patient p and take its beds.
+ */
+void place_patient(Solver &sv, unsigned p, const Assignments &as) {
+    const Instance &in = *sv.inst;
+    unsigned d, r;
+    sv.assignments[p] = as;
+    sv.assignments[p].cost = assignment_cost(in, p, as);
+    add_assignment_parts(in, p, as, 1, sv.objectives);
+    for (d = as.aday; d < as.dday; d++) {
+        r = room_on_day(as, d);
+        change_cell(sv, r, d, -1, 0);
+        count_gender(sv, r, d, in.patients[p].gender, 1);
+    }
+    add_risk(sv, p, as, 1);
+    if (as.tday == NO_DAY) {
+        sv.bed_trees.add(as.ra, as.aday, as.dday, -1);
+    } else {
+        sv.bed_trees.add(as.ra, as.aday, as.tday, -1);
+        sv.bed_trees.add(as.rb, as.tday, as.dday, -1);
+    }
+}
+
+/*
+ * take_days - patient p takes (step -1) or releases (step 1) the beds of room
+ * r on the days [from, to), with the gender counts.
+ */
+void take_days(Solver &sv, unsigned p, unsigned r, unsigned from,
+               unsigned to, int step) {
+    unsigned d;
+    Gender g = sv.inst->patients[p].gender;
+    if (from >= to) return;
+    for (d = from; d < to; d++) {
+        change_cell(sv, r, d, step, 0);
+        count_gender(sv, r, d, g, -step);
+    }
+    sv.bed_trees.add(r, from, to, step);
+}
+
+/*
+ * shift_patient - move the stay of patient p, in the same room and without a
+ * transfer before and after, to the days of as. Only the days leaving and
+ * entering the stay are updated; a DELAY by k days touches 2k days.
+ */
+void shift_patient(Solver &sv, unsigned p, const Assignments &as) {
+    const Assignments old = sv.assignments[p];
+    add_risk(sv, p, old, -1);
+    take_days(sv, p, old.ra, old.aday, min(old.dday, as.aday), 1);
+    take_days(sv, p, old.ra, max(old.aday, as.dday), old.dday, 1);
+    take_days(sv, p, as.ra, as.aday, min(as.dday, old.aday), -1);
+    take_days(sv, p, as.ra, max(as.aday, old.dday), as.dday, -1);
+    add_assignment_parts(*sv.inst, p, old, -1, sv.objectives);
+    add_assignment_parts(*sv.inst, p, as, 1, sv.objectives);
+    add_risk(sv, p, as, 1);
+    sv.assignments[p] = as;
+    sv.assignments[p].cost = assignment_cost(*sv.inst, p, as);
+}
+
+/*
+ * apply_move - apply a neighborhood move to the schedule.
+ */
+void apply_move(Solver &sv, const Moves &mv) {
+    if (mv.type == DELAY) {
+        shift_patient(sv, mv.p1, mv.a1);
+        return;
+    }
+    remove_patient(sv, mv.p1);
+    if (is_swap_move(mv.type)) remove_patient(sv, mv.p2);
+    place_patient(sv, mv.p1, mv.a1);
+    if (is_swap_move(mv.type)) place_patient(sv, mv.p2, mv.a2);
+}
+
+/*
+ * rebuild_occupancy - rebuild the free beds and the gender counts from the
+ * assignments.
+ */
+void rebuild_occupancy(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned p, r, d;
+    for (r = 0; r < in.num_rooms; r++)
+        for (d = 0; d < in.num_days; d++)
+            sv.beds[r][d] = in.rooms[r].capacity;
+    sv.bed_trees.build(sv.beds, in.num_days);
+    sv.room_genders.fill(0);
+    sv.gender_sums.fill(0);
+    sv.gender_cost = 0;
+    sv.at_risk.fill(0);
+    sv.risk_cost = 0;
+    memset(sv.objectives.parts, 0, sizeof(sv.objectives.parts));
+    for (p = 0; p < in.num_patients; p++) {
+        Assignments as = sv.assignments[p];
+        place_patient(sv, p, as);
+    }
+}
+
+/*
+ * cheapest_placement - the earliest admission day from day first on, within
+ * the slack of patient p, on which some available room is free over the whole
+ * stay, with its lowest-cost room. Returns false if there is none, with best
+ * overwritten.
+ */
+bool cheapest_placement(const Solver &sv, unsigned p, unsigned first,
+                        Assignments &best) {
+    const Instance &in = *sv.inst;
+    unsigned i, a, last, stay;
+
+    stay = valid_stay(in, p);
+    last = max(in.aday[p], min(in.max_aday[p], in.num_days - 1));
+    best.tday = NO_DAY;
+    best.rb = NO_ROOM;
+    // no delay pushes nights off the horizon; see latest_admission().
+    for (a = first; a <= last; a++) {
+        best.aday = a;
+        best.dday = a + stay;
+        // the candidates are cheapest first, so the first free one wins.
+        for (i = in.candidate_offsets[p]; i < in.candidate_offsets[p + 1];
+             i++) {
+            best.ra = in.candidate_rooms[i];
+            if (sv.bed_trees.min_free(best.ra, best.aday, best.dday) >= 1)
+                return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * generate_greedy_solution - generate the initial solution in one pass over
+ * the patients, the least flexible first: by slack (max_aday - aday), then by
+ * the number of available rooms, then longest stay first. Each patient gets
+ * the lowest-cost room that is free over its whole stay, delayed to the
+ * earliest day within its slack when no room is free on admission. Returns
+ * false if some patient cannot be placed.
+ */
+bool generate_greedy_solution(Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned i, p;
+    vector<unsigned> order(in.num_patients), room_count(in.num_patients, 0);
+    Assignments best;
+
+    reset_schedule(sv);
+    for (p = 0; p < in.num_patients; p++) {
+        order[p] = p;
+        room_count[p] = in.candidate_offsets[p + 1] - in.candidate_offsets[p];
+    }
+    stable_sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+        unsigned sx = in.max_aday[x] - min(in.max_aday[x],
+                                                  in.aday[x]);
+        unsigned sy = in.max_aday[y] - min(in.max_aday[y],
+                                                  in.aday[y]);
+        if (sx != sy) return sx < sy;
+        if (room_count[x] != room_count[y])
+            return room_count[x] < room_count[y];
+        return in.patients[x].dday - in.aday[x] >
+               in.patients[y].dday - in.aday[y];
+    });
+
+    for (i = 0; i < in.num_patients; i++) {
+        p = order[i];
+        if (!cheapest_placement(sv, p, in.aday[p], best)) {
+            *sv.out << "Failed p = " << p << endl;
+            return false;
+        }
+        place_patient(sv, p, best);
+        sv.tags[p] = best.dday < in.num_days ? DISCHARGED : ADMITTED;
+    }
+    *sv.out << "successfully generated an initial solution!" << endl;
+    return true;
+}
+
+/*
+ * Tabu memory - a stamp per patient and attribute holds the tabu clock until
+ * which the patient may not take it again, so a check is one lookup. Swapped
+ * pairs are hashed into a fixed table of at least 8 * TABU_TENURE slots, far
+ * more than the pairs tabu at once; a collision only forgets an older pair.
+ * Clearing the memory moves the clock past every stamp.
+ */
+
+/*
+ * clear_tabu - make all attributes admissible again, in O(1).
+ */
+void clear_tabu(Solver &sv) {
+    sv.tabu_clock += 2 * TABU_TENURE + 1;
+}
+
+/*
+ * swap_slot - the hash table slot of the pair of patients p < q.
+ */
+inline size_t swap_slot(const Solver &sv, unsigned p, unsigned q) {
+    uint32_t h = (p * 0x9e3779b1u) ^ (q * 0x85ebca6bu);
+    return (h ^ h >> 16) & (sv.swap_tabu.size() - 1);
+}
+
+/*
+ * is_tabu - whether attribute value is tabu for patient p.
+ */
+inline bool is_tabu(const Solver &sv, unsigned p, unsigned value) {
+    return sv.tabu_until[p][value] > sv.tabu_clock;
+}
+
+/*
+ * move_tabu - whether a move brings a patient back into a room, or to an
+ * admission day, that it has recently left, or swaps a pair of patients
+ * recently swapped.
+ */
+bool move_tabu(const Solver &sv, const Moves &mv) {
+    const Instance &in = *sv.inst;
+    unsigned i, p, n = is_swap_move(mv.type) ? 2 : 1;
+    for (i = 0; i < n; i++) {
+        p = i == 0 ? mv.p1 : mv.p2;
+        const Assignments &cur = sv.assignments[p];
+        const Assignments &nw = i == 0 ? mv.a1 : mv.a2;
+        if (nw.ra != cur.ra && nw.ra != cur.rb && is_tabu(sv, p, nw.ra))
+            return true;
+        if (nw.tday != NO_DAY && nw.rb != cur.ra && nw.rb != cur.rb &&
+            is_tabu(sv, p, nw.rb))
+            return true;
+        if (nw.aday != cur.aday && is_tabu(sv, p, in.num_rooms + nw.aday))
+            return true;
+    }
+    if (n == 2) {
+        unsigned lo = min(mv.p1, mv.p2), hi = max(mv.p1, mv.p2);
+        const SwapTabus &st = sv.swap_tabu[swap_slot(sv, lo, hi)];
+        return st.p1 == lo && st.p2 == hi && st.until > sv.tabu_clock;
+    }
+    return false;
+}
+
+/*
+ * tabu_tenure - the tenure of the attributes left now; TABU_TENURE, growing
+ * up to twice that as the search goes idle iterations without improvement of
+ * the best solution out of max_idle, to drive it away from where it cycles.
+ */
+unsigned tabu_tenure(unsigned idle, unsigned max_idle) {
+    return TABU_TENURE + TABU_TENURE * min(idle, max_idle) / max(max_idle, 1u);
+}
+
+/*
+ * make_tabu - forbid the moved patients to return to the rooms and the
+ * admission days they leave, and to be swapped again, for tenure iterations.
+ */
+void make_tabu(Solver &sv, const Moves &mv, unsigned tenure) {
+    const Instance &in = *sv.inst;
+    unsigned i, p, n = is_swap_move(mv.type) ? 2 : 1;
+    unsigned until = sv.tabu_clock + tenure;
+
+    for (i = 0; i < n; i++) {
+        p = i == 0 ? mv.p1 : mv.p2;
+        const Assignments &cur = sv.assignments[p];
+        const Assignments &nw = i == 0 ? mv.a1 : mv.a2;
+        unsigned *stamps = sv.tabu_until[p];
+        if (cur.ra != nw.ra && cur.ra != nw.rb) stamps[cur.ra] = until;
+        if (cur.tday != NO_DAY && cur.rb != nw.ra && cur.rb != nw.rb)
+            stamps[cur.rb] = until;
+        if (cur.aday != nw.aday) stamps[in.num_rooms + cur.aday] = until;
+    }
+    if (n == 2) {
+        SwapTabus &st = sv.swap_tabu[swap_slot(sv, min(mv.p1, mv.p2),
+                                               max(mv.p1, mv.p2))];
+        st.p1 = min(mv.p1, mv.p2);
+        st.p2 = max(mv.p1, mv.p2);
+        st.until = until;
+    }
+}
+
+/*
+ * keeps_past - whether the new assignment nw of a patient leaves its rooms on
+ * the days before today as they are in its current assignment cur.
+ */
+bool keeps_past(const Assignments &cur, const Assignments &nw, unsigned today) {
+    if (cur.aday >= today) return nw.aday >= today;
+    if (nw.aday != cur.aday || nw.ra != cur.ra) return false;
+    if (cur.tday != NO_DAY && cur.tday < today)
+        return nw.tday == cur.tday && nw.rb == cur.rb;
+    return nw.tday == NO_DAY || nw.tday >= today;
+}
+
+/*
+ * move_keeps_past - whether a move reschedules only days from today on.
+ */
+bool move_keeps_past(const Solver &sv, const Moves &mv) {
+    if (sv.today == 0) return true;
+    if (!keeps_past(sv.assignments[mv.p1], mv.a1, sv.today)) return false;
+    return !is_swap_move(mv.type) ||
+           keeps_past(sv.assignments[mv.p2], mv.a2, sv.today);
+}
+
+/*
+ * windowed - whether the search of sv is confined to a day window.
+ */
+inline bool windowed(const Solver &sv) {
+    return sv.window_lo > 0 || sv.window_hi < sv.inst->num_days;
+}
+
+/*
+ * move_in_window - whether a move keeps the moved patients within the day
+ * window of the search.
+ */
+bool move_in_window(const Solver &sv, const Moves &mv) {
+    if (!windowed(sv)) return true;
+    if (mv.a1.aday < sv.window_lo || mv.a1.dday > sv.window_hi) return false;
+    return !is_swap_move(mv.type) ||
+           (mv.a2.aday >= sv.window_lo && mv.a2.dday <= sv.window_hi);
+}
+
+/*
+ * max_gender_gain - a bound on the SAME_GENDER penalty a move can save, in
+ * O(1); entering a room never lowers its penalty, and a patient leaving it
+ * lowers it by at most GENDER_WEIGHT a day.
+ */
+int max_gender_gain(const Solver &sv, const Moves &mv) {
+    const Instance &in = *sv.inst;
+    unsigned i, days = 0, n = is_swap_move(mv.type) ? 2 : 1;
+    unsigned pts[2] = {mv.p1, mv.p2};
+    for (i = 0; i < n; i++) {
+        const Assignments &as = sv.assignments[pts[i]];
+        unsigned split = as.tday == NO_DAY ? as.dday : as.tday;
+        if (in.rooms[as.ra].policy == SAME_GENDER) days += split - as.aday;
+        if (as.tday != NO_DAY && in.rooms[as.rb].policy == SAME_GENDER)
+            days += as.dday - as.tday;
+    }
+    return static_cast<int>(GENDER_WEIGHT * days);
+}
+
+/*
+ * consider_move - evaluate the cost delta of a move and keep it as the best
+ * move of the neighborhood if it is feasible and admissible; a tabu move is
+ * admissible only if it improves on the best solution (aspiration). The
+ * SAME_GENDER and overcrowding risk terms are compiled in only for the
+ * instances of a Shape using them; without, they are zero.
+ */
+template <unsigned Shape>
+void consider_move(const Solver &sv, Neighborhoods &nb, Moves &mv) {
+    const Instance &in = *sv.inst;
+    COUNT(EVALUATED + mv.type - CHANGE);
+    mv.delta = static_cast<int>(assignment_cost(in, mv.p1, mv.a1)) -
+               static_cast<int>(sv.assignments[mv.p1].cost);
+    if (is_swap_move(mv.type))
+        mv.delta += static_cast<int>(assignment_cost(in, mv.p2, mv.a2)) -
+                    static_cast<int>(sv.assignments[mv.p2].cost);
+    int gain = 0;
+    if constexpr ((Shape & SHAPE_SAME_GENDER) != 0)
+        gain += max_gender_gain(sv, mv);
+    if constexpr ((Shape & SHAPE_VARIABILITY) != 0)
+        gain += risk_gain(sv, mv.p1) +
+                (is_swap_move(mv.type) ? risk_gain(sv, mv.p2) : 0);
+    if (nb.found && mv.delta - gain >= nb.best.delta) return;
+    if constexpr ((Shape & SHAPE_SAME_GENDER) != 0)
+        mv.delta += gender_delta(sv, mv);
+    if constexpr ((Shape & SHAPE_VARIABILITY) != 0)
+        mv.delta += risk_delta(sv, mv);
+    if (nb.found && mv.delta >= nb.best.delta) return;
+    if (!move_keeps_past(sv, mv) || !move_in_window(sv, mv)) return;
+
+    if (nb.current_cost + mv.delta >= nb.best_cost) {
+        if (move_tabu(sv, mv)) {
+            COUNT(TABU_REJECTED);
+            return;
+        }
+    }
+#ifdef PASU_INSTRUMENT
+    else if (move_tabu(sv, mv))
+        COUNT(ASPIRATION_HITS);
+#endif
+    if (!move_feasible(sv, mv)) {
+        COUNT(INFEASIBLE);
+        return;
+    }
+
+    nb.best = mv;
+    nb.found = true;
+    if (FIRST_IMPROVEMENT && mv.delta < 0) nb.done = true;
+}
+
+/*
+ * scan_change - CHANGE moves; patient p stays in one other room. The
+ * candidate rooms come cheapest first, so the room cost deltas only grow;
+ * if prune is set, the scan stops once they cannot beat the best move even
+ * with the largest SAME_GENDER and overcrowding risk gains of p leaving its
+ * room, a lower bound of the rest of the move delta.
+ */
+template <unsigned Shape>
+void scan_change(const Solver &sv, Neighborhoods &nb, unsigned p,
+                 bool prune) {
+    const Instance &in = *sv.inst;
+    unsigned i, r;
+    const Assignments &cur = sv.assignments[p];
+    int least = 0;
+    if constexpr ((Shape & SHAPE_SAME_GENDER) != 0) least += leave_gain(sv, p);
+    if constexpr ((Shape & SHAPE_VARIABILITY) != 0) least -= risk_gain(sv, p);
+    Moves mv;
+    mv.type = CHANGE;
+    mv.p1 = mv.p2 = p;
+    for (i = in.candidate_offsets[p];
+         i < in.candidate_offsets[p + 1] && !nb.done; i++) {
+        r = in.candidate_rooms[i];
+        if (r == cur.ra && cur.tday == NO_DAY) continue;
+        mv.a1 = cur;
+        mv.a1.ra = r;
+        mv.a1.tday = NO_DAY;
+        mv.a1.rb = NO_ROOM;
+        if (prune && nb.found &&
+            static_cast<int>(assignment_cost(in, p, mv.a1)) -
+            static_cast<int>(cur.cost) + least >= nb.best.delta)
+            break;
+        consider_move<Shape>(sv, nb, mv);
+    }
+}
+
+/*
+ * explore_change - the CHANGE moves of patient p, pruned. With VERIFY_COST,
+ * an unpruned scan from the same state must find a move as good, or the
+ * search stops.
+ */
+template <unsigned Shape>
+void explore_change(const Solver &sv, Neighborhoods &nb, unsigned p) {
+    if (!VERIFY_COST) {
+        scan_change<Shape>(sv, nb, p, true);
+        return;
+    }
+    Neighborhoods full = nb;
+    scan_change<Shape>(sv, nb, p, true);
+    scan_change<Shape>(sv, full, p, false);
+    if (nb.found != full.found ||
+        (nb.found && nb.best.delta != full.best.delta)) {
+        cerr << "CHANGE pruning missed a move of patient " << p << ": delta "
+             << (nb.found ? nb.best.delta : 0) << ", unpruned "
+             << full.best.delta << endl;
+        abort();
+    }
+}
+
+/*
+ * num_partners - the number of swap partners of the current exploration.
+ */
+inline unsigned num_partners(const Instance &in, const Neighborhoods &nb) {
+    if (!nb.partners.empty()) return nb.partners.size();
+    return nb.pool != NULL ? nb.pool->size() : in.num_patients;
+}
+
+/*
+ * partner - swap partner i of the current exploration; the sampled ones, or
+ * all patients of the pool from the offset on, wrapping around.
+ */
+inline unsigned partner(const Instance &in, const Neighborhoods &nb,
+                        unsigned i) {
+    if (!nb.partners.empty()) return nb.partners[i];
+    i += nb.offset;
+    if (nb.pool == NULL) return i < in.num_patients ? i : i - in.num_patients;
+    return (*nb.pool)[i < nb.pool->size() ? i : i - nb.pool->size()];
+}
+
+/*
+ * explore_swap - SWAP moves; patient p and another patient exchange rooms.
+ */
+template <unsigned Shape>
+void explore_swap(const Solver &sv, Neighborhoods &nb, unsigned p) {
+    const Instance &in = *sv.inst;
+    unsigned i, q, n = num_partners(in, nb);
+    const Assignments &cur = sv.assignments[p];
+    Moves mv;
+    if (cur.tday != NO_DAY) return;
+    mv.type = SWAP;
+    mv.p1 = p;
+    for (i = 0; i < n && !nb.done; i++) {
+        q = partner(in, nb, i);
+        const Assignments &other = sv.assignments[q];
+        if (q == p || other.tday != NO_DAY || other.ra == cur.ra) continue;
+        if (!in.patient_room_availability[p][other.ra] ||
+            !in.patient_room_availability[q][cur.ra])
+            continue;
+        mv.p2 = q;
+        mv.a1 = cur;
+        mv.a1.ra = other.ra;
+        mv.a2 = other;
+        mv.a2.ra = cur.ra;
+        consider_move<Shape>(sv, nb, mv);
+    }
+}
+
+/*
+ * explore_delay - DELAY moves; shift the admission of patient p to another
+ * day between its original admission day and max_aday.
+ */
+template <unsigned Shape>
+void explore_delay(const Solver &sv, Neighborhoods &nb, unsigned p) {
+    const Instance &in = *sv.inst;
+    unsigned a, last, stay;
+    const Assignments &cur = sv.assignments[p];
+    Moves mv;
+    if (cur.tday != NO_DAY) return;
+    mv.type = DELAY;
+    mv.p1 = mv.p2 = p;
+    stay = valid_stay(in, p);
+    last = min(in.max_aday[p], in.num_days - 1);
+    for (a = in.aday[p]; a <= last && !nb.done; a++) {
+        if (a == cur.aday) continue;
+        mv.a1 = cur;
+        mv.a1.aday = a;
+        mv.a1.dday = a + stay;
+        consider_move<Shape>(sv, nb, mv);
+    }
+}
+
+/*
+ * explore_partial_change - PARTIAL_CHANGE moves; patient p transfers to
+ * another room for the rest of its stay. The cost is linear in the transfer
+ * day, so only the earliest and the latest feasible days are evaluated.
+ */
+template <unsigned Shape>
+void explore_partial_change(const Solver &sv, Neighborhoods &nb, unsigned p) {
+    const Instance &in = *sv.inst;
+    unsigned i, r, t, t_lo, t_hi, mid;
+    const Assignments &cur = sv.assignments[p];
+    const Assignments *own[1] = {&cur};
+    Moves mv;
+    if (cur.dday - cur.aday < 2) return;
+    mv.type = PARTIAL_CHANGE;
+    mv.p1 = mv.p2 = p;
+
+    // latest transfer day for which room ra stays free from admission.
+    t_lo = cur.aday + 1;
+    t_hi = cur.dday - 1;
+    while (t_lo < t_hi) {
+        mid = (t_lo + t_hi + 1) / 2;
+        if (beds_free(sv, cur.ra, cur.aday, mid, own, 1, NULL)) t_lo = mid;
+        else t_hi = mid - 1;
+    }
+    t_hi = t_lo;
+
+    for (i = in.candidate_offsets[p];
+         i < in.candidate_offsets[p + 1] && !nb.done; i++) {
+        r = in.candidate_rooms[i];
+        if (r == cur.ra) continue;
+        if (!beds_free(sv, r, cur.dday - 1, cur.dday, own, 1, NULL)) continue;
+
+        // earliest transfer day for which room r stays free until discharge.
+        t_lo = cur.aday + 1;
+        t = cur.dday - 1;
+        while (t_lo < t) {
+            mid = (t_lo + t) / 2;
+            if (beds_free(sv, r, mid, cur.dday, own, 1, NULL)) t = mid;
+            else t_lo = mid + 1;
+        }
+        if (t_lo > t_hi) continue;
+
+        for (t = t_lo;; t = t_hi) {
+            if (t != cur.tday || r != cur.rb) {
+                mv.a1 = cur;
+                mv.a1.tday = t;
+                mv.a1.rb = r;
+                consider_move<Shape>(sv, nb, mv);
+            }
+            if (t == t_hi) break;
+        }
+    }
+}
+
+/*
+ * explore_partial_swap - PARTIAL_SWAP moves; patient p and a patient staying
+ * at the same time exchange rooms from a transfer day on. Only the earliest
+ * and the latest common transfer days are evaluated.
+ */
+template <unsigned Shape>
+void explore_partial_swap(const Solver &sv, Neighborhoods &nb, unsigned p) {
+    const Instance &in = *sv.inst;
+    unsigned i, q, t, t_lo, t_hi, n = num_partners(in, nb);
+    const Assignments &cur = sv.assignments[p];
+    Moves mv;
+    if (cur.tday != NO_DAY) return;
+    mv.type = PARTIAL_SWAP;
+    mv.p1 = p;
+    for (i = 0; i < n && !nb.done; i++) {
+        q = partner(in, nb, i);
+        const Assignments &other = sv.assignments[q];
+        if (q == p || other.tday != NO_DAY || other.ra == cur.ra) continue;
+        // most patients do not stay at the same time; test that first.
+        t_lo = max(cur.aday, other.aday) + 1;
+        t_hi = min(cur.dday, other.dday);
+        if (t_hi < 1 || t_lo > --t_hi) continue;
+        if (!in.patient_room_availability[p][other.ra] ||
+            !in.patient_room_availability[q][cur.ra])
+            continue;
+
+        mv.p2 = q;
+        for (t = t_lo;; t = t_hi) {
+            mv.a1 = cur;
+            mv.a1.tday = t;
+            mv.a1.rb = other.ra;
+            mv.a2 = other;
+            mv.a2.tday = t;
+            mv.a2.rb = cur.ra;
+            consider_move<Shape>(sv, nb, mv);
+            if (t == t_hi) break;
+        }
+    }
+}
+
+/*
+ * pick_worst - the next patient of the round in WORST_PICK; the rounds visit
+ * every patient (those in focus during a repair) once, by assignment cost as
+ * of the start of the round, worst first. A moved patient waits for the next
+ * round, which keeps the search from circling around a few costly patients.
+ */
+unsigned pick_worst(const Solver &sv, Neighborhoods &nb) {
+    unsigned i, p;
+    if (nb.worst.empty()) {
+        if (sv.focus.empty()) {
+            for (p = 0; p < sv.inst->num_patients; p++)
+                nb.worst.push_back(make_pair(sv.assignments[p].cost, p));
+        } else {
+            for (i = 0; i < sv.focus.size(); i++) {
+                p = sv.focus[i];
+                nb.worst.push_back(make_pair(sv.assignments[p].cost, p));
+            }
+        }
+        make_heap(nb.worst.begin(), nb.worst.end());
+    }
+    pop_heap(nb.worst.begin(), nb.worst.end());
+    p = nb.worst.back().second;
+    nb.worst.pop_back();
+    return p;
+}
+
+/*
+ * pick_patient - the patient whose neighborhood is explored in PICK_MODE;
+ * at random or worst first, among the patients in focus during a repair.
+ */
+unsigned pick_patient(Solver &sv, Neighborhoods &nb) {
+    if (PICK_MODE == WORST_PICK) return pick_worst(sv, nb);
+    if (!sv.focus.empty()) return sv.focus[sv.rng.below(sv.focus.size())];
+    return sv.rng.below(sv.inst->num_patients);
+}
+
+/*
+ * start_neighborhood - start the exploration of an iteration; draw the swap
+ * partners, SWAP_SAMPLE random patients or a random offset of a full scan
+ * for a first improvement, and pick the patient to explore. In a window the
+ * partners are the patients in focus, as no other patient may move.
+ */
+unsigned start_neighborhood(Solver &sv, Neighborhoods &nb) {
+    const Instance &in = *sv.inst;
+    unsigned i;
+    nb.found = nb.done = false;
+    nb.offset = 0;
+    nb.pool = windowed(sv) ? &sv.focus : NULL;
+    unsigned n = nb.pool != NULL ? nb.pool->size() : in.num_patients;
+    nb.partners.clear();
+    if (SWAP_SAMPLE > 0 && SWAP_SAMPLE < n) {
+        for (i = 0; i < SWAP_SAMPLE; i++)
+            nb.partners.push_back(nb.pool != NULL
+                                  ? (*nb.pool)[sv.rng.below(n)]
+                                  : sv.rng.below(n));
+    } else if (FIRST_IMPROVEMENT) {
+        nb.offset = sv.rng.below(n);
+    }
+    return pick_patient(sv, nb);
+}
+
+/*
+ * search_neighborhood_s0 - s0 is the smaller solution space which doesn't
+ * allow patient transferring. Explores the CHANGE, SWAP and DELAY moves of a
+ * patient picked in PICK_MODE.
+ */
+template <unsigned Shape>
+bool search_neighborhood_s0(Solver &sv, Neighborhoods &nb) {
+    unsigned p = start_neighborhood(sv, nb);
+    explore_change<Shape>(sv, nb, p);
+    explore_swap<Shape>(sv, nb, p);
+    explore_delay<Shape>(sv, nb, p);
+    return nb.found;
+}
+
+/*
+ * search_neighborhood_s1 - s1 is the larger solution space which allows
+ * patient transferring; the s0 moves plus PARTIAL_CHANGE and PARTIAL_SWAP.
+ */
+template <unsigned Shape>
+bool search_neighborhood_s1(Solver &sv, Neighborhoods &nb) {
+    unsigned p = start_neighborhood(sv, nb);
+    explore_change<Shape>(sv, nb, p);
+    explore_swap<Shape>(sv, nb, p);
+    explore_delay<Shape>(sv, nb, p);
+    explore_partial_change<Shape>(sv, nb, p);
+    explore_partial_swap<Shape>(sv, nb, p);
+    return nb.found;
+}
+
+/* A neighborhood search, one iteration of tabu_search(). */
+typedef bool (*NeighborhoodSearch)(Solver &, Neighborhoods &);
+
+/*
+ * neighborhood_search - the search of s0, or of s1 if transfers are allowed,
+ * specialized for the SAME_GENDER rooms and the overstays the instance has.
+ */
+NeighborhoodSearch neighborhood_search(const Instance &in,
+                                       bool allow_transfer) {
+    const unsigned G = SHAPE_SAME_GENDER, V = SHAPE_VARIABILITY;
+    switch (in.shape & (G | V)) {
+    case 0:
+        return allow_transfer ? search_neighborhood_s1<0>
+                              : search_neighborhood_s0<0>;
+    case G:
+        return allow_transfer ? search_neighborhood_s1<G>
+                              : search_neighborhood_s0<G>;
+    case V:
+        return allow_transfer ? search_neighborhood_s1<V>
+                              : search_neighborhood_s0<V>;
+    default:
+        return allow_transfer ? search_neighborhood_s1<G | V>
+                              : search_neighborhood_s0<G | V>;
+    }
+}
+
+/*
+ * restore_assignments - make best the assignments of sv, re-placing only the
+ * patients whose assignment differs.
+ */
+void restore_assignments(Solver &sv, const vector<Assignments> &best) {
+    const Instance &in = *sv.inst;
+    unsigned p;
+    vector<unsigned> changed;
+    for (p = 0; p < in.num_patients; p++) {
+        const Assignments &a = sv.assignments[p], &b = best[p];
+        if (a.aday != b.aday || a.tday != b.tday || a.dday != b.dday ||
+            a.ra != b.ra || a.rb != b.rb)
+            changed.push_back(p);
+    }
+    for (p = 0; p < changed.size(); p++) remove_patient(sv, changed[p]);
+    for (p = 0; p < changed.size(); p++)
+        place_patient(sv, changed[p], best[changed[p]]);
+}
+
+/*
+ * append_number - append the decimal digits of v to buf, or "-" if v is the
+ * none value.
+ */
+void append_number(string &buf, unsigned v, unsigned none) {
+    char digits[10];
+    int n = 0;
+    if (v == none) {
+        buf += '-';
+        return;
+    }
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n > 0) buf += digits[--n];
+}
+
+/*
+ * append_text - append the text solution to buf; one line per patient with
+ * its tag and its room per day, "-" off its stay. The rooms are those of the
+ * assignments as, or of the current assignments if as is NULL.
+ */
+void append_text(string &buf, const Solver &sv,
+                 const vector<Assignments> *as) {
+    const Instance &in = *sv.inst;
+    unsigned p, d, r;
+    if (as == NULL) as = &sv.assignments;
+    buf.reserve(buf.size() + in.num_patients * (in.num_days * 3 + 16));
+    for (p = 0; p < in.num_patients; p++) {
+        buf += "Pat_";
+        append_number(buf, p, UINT_MAX);
+        buf += " [";
+        append_number(buf, sv.tags[p], UINT_MAX);
+        buf += "]  ";
+        for (d = 0; d < in.num_days; d++) {
+            r = room_on_day((*as)[p], d);
+            append_number(buf, r, NO_ROOM);
+            buf += ' ';
+        }
+        buf += '\n';
+    }
+}
+
+/*
+ * append_compact - append the compact solution to buf; a header, then one
+ * line per patient with the fields of its assignment,
+ *
+ *     <patient> <room a> <admission day> <transfer day> <discharge day>
+ *     <room b>
+ *
+ * "-" for no transfer or no room. Given a baseline, this is the diff format;
+ * only the patients whose assignment differs from it are listed.
+ */
+void append_compact(string &buf, const Solver &sv,
+                    const vector<Assignments> &as, unsigned cost,
+                    const vector<Assignments> *baseline) {
+    const Instance &in = *sv.inst;
+    unsigned p;
+    vector<unsigned> listed;
+    for (p = 0; p < in.num_patients; p++) {
+        if (baseline == NULL || p >= baseline->size() ||
+            !same_assignment((*baseline)[p], as[p]))
+            listed.push_back(p);
+    }
+
+    buf.reserve(buf.size() + listed.size() * 32 + 64);
+    buf += baseline != NULL ? "Solution: diff 1\n" : "Solution: compact 1\n";
+    buf += "Patients: ";
+    append_number(buf, in.num_patients, UINT_MAX);
+    buf += "\nDays: ";
+    append_number(buf, in.num_days, UINT_MAX);
+    buf += "\nCost: ";
+    append_number(buf, cost, UINT_MAX);
+    buf += "\nListed: ";
+    append_number(buf, listed.size(), UINT_MAX);
+    buf += '\n';
+    for (p = 0; p < listed.size(); p++) {
+        const Assignments &a = as[listed[p]];
+        append_number(buf, listed[p], UINT_MAX);
+        buf += ' ';
+        append_number(buf, a.ra, NO_ROOM);
+        buf += ' ';
+        append_number(buf, a.aday, NO_DAY);
+        buf += ' ';
+        append_number(buf, a.tday, NO_DAY);
+        buf += ' ';
+        append_number(buf, a.dday, NO_DAY);
+        buf += ' ';
+        append_number(buf, a.tday != NO_DAY ? a.rb : NO_ROOM, NO_ROOM);
+        buf += '\n';
+    }
+}
+
+/*
+ * stream_incumbent - write out the incumbent as of cost cost if it is better
+ * than the last one written and INCUMBENT_INTERVAL_MS have passed since, or
+ * always if forced. A line is logged to the output, and the schedule goes to
+ * a temporary file renamed over INCUMBENT_FILE, so that a reader finds the
+ * whole of the latest schedule at any time.
+ */
+void stream_incumbent(Solver &sv, int cost, const vector<Assignments> &as,
+                      bool force) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (INCUMBENT_FILE.empty() || cost >= sv.streamed_cost) return;
+    if (!force && sv.streamed_cost != INT_MAX &&
+        now - sv.streamed_at < chrono::milliseconds(INCUMBENT_INTERVAL_MS))
+        return;
+    sv.streamed_cost = cost;
+    sv.streamed_at = now;
+    *sv.out << "Incumbent Cost = " << cost << " at " << fixed
+            << setprecision(0) << elapsed_ms(sv.start) << " ms" << endl;
+
+    string buf, tmp = INCUMBENT_FILE + ".tmp";
+    if (OUTPUT_FORMAT == TEXT_OUTPUT) {
+        append_text(buf, sv, &as);
+        buf += "Total Cost = ";
+        append_number(buf, cost, UINT_MAX);
+        buf += '\n';
+    } else
+        append_compact(buf, sv, as, cost, NULL);
+    {
+        ofstream os(tmp, ios_base::out | ios_base::binary);
+        if (!os.is_open()) return;
+        os.write(buf.data(), buf.size());
+    }
+    error_code ec;
+    filesystem::rename(tmp, INCUMBENT_FILE, ec);
+}
+
+/*
+ * stop_reason - whether a tabu search stops; at the iteration limit, after
+ * max_idle iterations without improvement, past the deadline of the run
+ * (checked every 64 iterations), or within GAP_LIMIT of the lower bound.
+ * NO_STOP to go on.
+ */
+StopReason stop_reason(const Solver &sv, const Neighborhoods &nb,
+                       unsigned idle, unsigned max_iter, unsigned max_idle) {
+    const Instance &in = *sv.inst;
+    if (nb.iter >= max_iter) return STOP_ITERATIONS;
+    if (idle >= max_idle) return STOP_IDLE;
+    if (nb.iter % 64 == 0 && chrono::steady_clock::now() >= sv.deadline)
+        return STOP_TIME;
+    if (GAP_LIMIT >= 0 &&
+        nb.best_cost <= in.lower_bound * (1 + GAP_LIMIT))
+        return STOP_GAP;
+    return NO_STOP;
+}
+
+/*
+ * migrate - adopt the elite of the next thread on the ring if it is better
+ * than the best solution of this thread. Returns whether it was adopted.
+ */
+bool migrate(Solver &sv, Neighborhoods &nb, const Migrations &mg,
+             vector<Assignments> &best) {
+    const SharedElite &slot = mg.elites[(mg.thread + 1) % mg.num_threads];
+    if (slot.cost() >= nb.best_cost) return false;
+    shared_ptr<const Elites> elite = slot.load();
+    if (!elite || elite->cost >= nb.best_cost) return false;
+
+    sv.assignments = elite->assignments;
+    rebuild_occupancy(sv);
+    clear_tabu(sv);
+    nb.worst.clear();
+    nb.current_cost = nb.best_cost = elite->cost;
+    best = sv.assignments;
+    mg.elites[mg.thread].publish(nb.best_cost, best);
+    return true;
+}
+
+/*
+ * tabu_search - improve the current assignments by tabu search in solution
+ * space s0, or s1 if transfers are allowed. Stops after MAX_ITERATIONS, or
+ * MAX_IDLE_ITERATIONS without improvement (the repair limits when only the
+ * patients in focus are repaired, not in a window), at the deadline or the
+ * gap limit, and
+ * restores the best solution. Improvements are streamed out as they come.
+ * In a parallel search, improvements are published, the first thread
+ * streams the shared incumbent, and elites migrate every MIGRATION_INTERVAL
+ * iterations. Returns the number of iterations.
+ */
+unsigned tabu_search(Solver &sv, bool allow_transfer, Migrations *mg) {
+    const Instance &in = *sv.inst;
+    unsigned p, idle = 0;
+    bool repair = !sv.focus.empty() && !windowed(sv);
+    unsigned max_iter = repair ? REPAIR_ITERATIONS : MAX_ITERATIONS;
+    unsigned max_idle = repair ? REPAIR_IDLE_ITERATIONS : MAX_IDLE_ITERATIONS;
+    Neighborhoods nb;
+    NeighborhoodSearch neighborhood = neighborhood_search(in, allow_transfer);
+    vector<Assignments> best(in.num_patients);
+    PHASE_TIMER(PHASE_SEARCH);
+
+    calculate_cost(sv);
+    nb.current_cost = nb.best_cost = static_cast<int>(sv.total_cost);
+    for (p = 0; p < in.num_patients; p++) best[p] = sv.assignments[p];
+    clear_tabu(sv);
+
+    for (nb.iter = 0;; nb.iter++, sv.tabu_clock++) {
+        sv.stop = stop_reason(sv, nb, idle, max_iter, max_idle);
+        if (sv.stop != NO_STOP) break;
+        if (nb.iter % 64 == 0 && sv.focus.empty()) {
+            if (mg == NULL)
+                stream_incumbent(sv, nb.best_cost, best, false);
+            else if (mg->thread == 0 &&
+                     mg->incumbent->cost() < sv.streamed_cost) {
+                shared_ptr<const Elites> elite = mg->incumbent->load();
+                stream_incumbent(sv, elite->cost, elite->assignments, false);
+            }
+        }
+#ifdef PASU_INSTRUMENT
+        if (STATS_INTERVAL > 0 && nb.iter % STATS_INTERVAL == 0 &&
+            (mg == NULL ? !windowed(sv) : mg->thread == 0))
+            print_stats_row(*sv.out, nb.iter, nb.current_cost, nb.best_cost);
+#endif
+        if (mg != NULL && mg->num_threads > 1 && nb.iter > 0 &&
+            nb.iter % MIGRATION_INTERVAL == 0 && migrate(sv, nb, *mg, best))
+            idle = 0;
+
+        if (!neighborhood(sv, nb)) {
+            idle++;
+            continue;
+        }
+        make_tabu(sv, nb.best, tabu_tenure(idle, max_idle));
+        apply_move(sv, nb.best);
+        nb.current_cost += nb.best.delta;
+        if (VERIFY_COST && !verify_objectives(sv, nb.current_cost)) abort();
+        COUNT(ACCEPTED);
+
+        if (nb.current_cost < nb.best_cost) {
+            nb.best_cost = nb.current_cost;
+            for (p = 0; p < in.num_patients; p++) best[p] = sv.assignments[p];
+            idle = 0;
+            if (mg != NULL) {
+                mg->elites[mg->thread].publish(nb.best_cost, best);
+                mg->incumbent->publish(nb.best_cost, best);
+            }
+        } else
+            idle++;
+    }
+
+    // restore the best solution found.
+    restore_assignments(sv, best);
+    calculate_cost(sv);
+    return nb.iter;
+}
+
+/*
+ * search_thread - one thread of the parallel search; tabu search in s0, then
+ * in s1. Stores its number of iterations in iterations.
+ */
+void search_thread(Solver *sv, Migrations mg, unsigned *iterations) {
+    *iterations = tabu_search(*sv, false, &mg);
+    *iterations += tabu_search(*sv, true, &mg);
+    merge_stats();
+}
+
+/*
+ * parallel_tabu_search - run num_threads independent tabu searches from the
+ * current solution of sv, each with its own random seed, sharing the best
+ * incumbent and migrating elites. The best solution found by any thread is
+ * taken over into sv. Returns the total number of iterations.
+ */
+unsigned parallel_tabu_search(Solver &sv, unsigned num_threads) {
+    unsigned t, total = 0;
+    vector<Solver> solvers(num_threads, sv);
+    vector<SharedElite> elites(num_threads);
+    vector<unsigned> iterations(num_threads, 0);
+    vector<thread> threads;
+    SharedElite incumbent;
+
+    calculate_cost(sv);
+    incumbent.publish(static_cast<int>(sv.total_cost), sv.assignments);
+    for (t = 0; t < num_threads; t++) {
+        Migrations mg = {&incumbent, &elites[0], num_threads, t};
+        solvers[t].rng.seed(sv.rng());
+        threads.push_back(thread(search_thread, &solvers[t], mg,
+                                 &iterations[t]));
+    }
+    for (t = 0; t < num_threads; t++) {
+        threads[t].join();
+        total += iterations[t];
+    }
+
+    sv.assignments = incumbent.load()->assignments;
+    sv.streamed_cost = solvers[0].streamed_cost;
+    sv.streamed_at = solvers[0].streamed_at;
+    rebuild_occupancy(sv);
+    calculate_cost(sv);
+    return total;
+}
+
+/*
+ * Decomposition - the horizon is split into windows of WINDOW_DAYS days. A
+ * window searches only the patients staying within it, and keeps them there;
+ * the patients crossing its bounds and those of the other windows are fixed.
+ * As the windows use the beds of disjoint days, they are solved at once on
+ * copies of the solver and stitched, and the stitched schedule is feasible.
+ * A second pass shifts the windows by half a window, so that the patients
+ * fixed at the bounds of the first pass get searched too.
+ */
+
+/*
+ * DayWindows - one window of a decomposition pass; its days, its patients,
+ * and the worker that solved it.
+ */
+struct DayWindows {
+    unsigned lo, hi;                    /* days [lo, hi) */
+    vector<unsigned> patients;          /* patients staying within */
+    unsigned worker;                    /* worker solving it */
+};
+
+/*
+ * window_worker - worker w of a decomposition pass; solves the windows it
+ * takes from the pool on its own solver (whose patients of other windows
+ * stay where they are), in s0 and then in s1.
+ */
+void window_worker(WorkQueues *pool, unsigned w, Solver *sv,
+                   vector<DayWindows> *windows, unsigned *iterations) {
+    unsigned j;
+    while (pool->pop(w, j)) {
+        DayWindows &win = (*windows)[j];
+        win.worker = w;
+        sv->focus = win.patients;
+        sv->window_lo = win.lo;
+        sv->window_hi = win.hi;
+        *iterations += tabu_search(*sv, false, NULL);
+        *iterations += tabu_search(*sv, true, NULL);
+    }
+    sv->focus.clear();
+    sv->window_lo = 0;
+    sv->window_hi = sv->inst->num_days;
+    merge_stats();
+}
+
+/*
+ * window_pass - one decomposition pass, its first window ending on day first;
+ * the windows are solved by up to NUM_THREADS workers, the most crowded
+ * first, and their patients stitched back into sv. Returns the number of
+ * iterations.
+ */
+unsigned window_pass(Solver &sv, unsigned first) {
+    const Instance &in = *sv.inst;
+    unsigned j, k, p, lo, total = 0;
+    vector<DayWindows> windows;
+    vector<unsigned> order;
+    vector<thread> threads;
+
+    for (lo = 0; lo < in.num_days; lo = windows.back().hi) {
+        DayWindows win;
+        win.lo = lo;
+        win.hi = min(lo == 0 ? first : lo + WINDOW_DAYS, in.num_days);
+        for (p = 0; p < in.num_patients; p++) {
+            const Assignments &as = sv.assignments[p];
+            if (as.aday >= win.lo && as.dday <= win.hi && as.aday < as.dday)
+                win.patients.push_back(p);
+        }
+        windows.push_back(win);
+        if (!win.patients.empty()) order.push_back(windows.size() - 1);
+    }
+    if (order.empty()) return 0;
+    stable_sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+        return windows[x].patients.size() > windows[y].patients.size();
+    });
+
+    unsigned num_workers = min(NUM_THREADS, static_cast<unsigned>(
+                                                order.size()));
+    WorkQueues pool(num_workers, order);
+    vector<Solver> solvers(num_workers, sv);
+    vector<unsigned> iterations(num_workers, 0);
+    for (k = 0; k < num_workers; k++) {
+        solvers[k].rng.seed(sv.rng());
+        threads.push_back(thread(window_worker, &pool, k, &solvers[k],
+                                 &windows, &iterations[k]));
+    }
+    for (k = 0; k < num_workers; k++) {
+        threads[k].join();
+        total += iterations[k];
+    }
+
+    vector<Assignments> stitched = sv.assignments;
+    for (j = 0; j < order.size(); j++) {
+        const DayWindows &win = windows[order[j]];
+        for (k = 0; k < win.patients.size(); k++) {
+            p = win.patients[k];
+            stitched[p] = solvers[win.worker].assignments[p];
+        }
+    }
+    restore_assignments(sv, stitched);
+    calculate_cost(sv);
+    return total;
+}
+
+/*
+ * window_search - solve the windows of the horizon in two passes, the second
+ * shifted by half a window, as the start of the global search. Returns the
+ * number of iterations.
+ */
+unsigned window_search(Solver &sv) {
+    unsigned n = window_pass(sv, WINDOW_DAYS);
+    if (WINDOW_DAYS > 1) n += window_pass(sv, WINDOW_DAYS / 2);
+    return n;
+}
+
+/*
+ * add_patient - append a registering patient to the instance and to the
+ * solver, with no room yet. Its overlaps with the other patients are not
+ * added to the overlap lists, which describe the instance file only.
+ */
+unsigned add_patient(Instance &in, Solver &sv) {
+    unsigned p = in.num_patients++;
+    Assignments as;
+
+    in.patients.push_back(Patients());
+    in.aday.push_back(0);
+    in.valid_dday.push_back(0);
+    in.max_aday.push_back(0);
+    in.preferred_cap.push_back(0);
+    in.patient_specialism_needed.push_back(0);
+    in.needed_features.append_row(0);
+    in.preferred_features.append_row(0);
+    in.total_patient_room_cost.append_row(0);
+    in.patient_room_availability.append_row(true);
+    in.overlap_offsets.push_back(in.overlap_offsets.back());
+
+    sv.tags.push_back(REGISTERED);
+    sv.tabu_until.append_row(0);
+    as.aday = as.dday = 0;
+    as.tday = NO_DAY;
+    as.ra = as.rb = NO_ROOM;
+    as.cost = 0;
+    sv.assignments.push_back(as);
+    return p;
+}
+
+/*
+ * set_stay - change the length of stay of patient p (from its original
+ * admission day), with the total days, the lower bound and the latest
+ * admission day.
+ */
+void set_stay(Instance &in, unsigned p, unsigned stay) {
+    Patients *pat = &in.patients[p];
+    int cost = min_room_cost(in, p);
+    unsigned old_stay = pat->dday - in.aday[p], old_valid = valid_stay(in, p);
+
+    pat->dday = in.aday[p] + stay;
+    in.valid_dday[p] = min(pat->dday, in.num_days);
+    in.max_aday[p] = latest_admission(in, p);
+    in.total_days += stay - old_stay;
+    if (cost != -1) in.lower_bound += static_cast<unsigned>(cost) *
+                                      (valid_stay(in, p) - old_valid);
+}
+
+/*
+ * assignment_free - whether the beds of assignment as are all free.
+ */
+bool assignment_free(const Solver &sv, const Assignments &as) {
+    unsigned split = as.tday == NO_DAY ? as.dday : as.tday;
+    if (!beds_free(sv, as.ra, as.aday, split, NULL, 0, NULL)) return false;
+    return as.tday == NO_DAY ||
+           beds_free(sv, as.rb, as.tday, as.dday, NULL, 0, NULL);
+}
+
+/*
+ * reschedule_stay - find free beds for the stay as of a patient off the
+ * schedule, keeping its days before today; as it is if free, and if not
+ * admitted yet no later than its latest admission day; else admitted anew if
+ * not admitted yet, else transferred for the rest of the stay to the cheapest
+ * free room as late as its room allows. Returns false if none.
+ */
+bool reschedule_stay(const Solver &sv, unsigned p, Assignments &as) {
+    const Instance &in = *sv.inst;
+    const unsigned today = sv.today;
+    unsigned i, r, t, t_lo, t_hi, mid;
+
+    if (as.aday >= today) {
+        if (as.aday <= in.max_aday[p] && assignment_free(sv, as)) return true;
+        return cheapest_placement(sv, p, max(in.aday[p], today), as);
+    }
+    if (assignment_free(sv, as)) return true;
+    if (as.tday != NO_DAY && as.tday < today) return false;
+
+    // latest transfer day for which room ra stays free from admission.
+    t_lo = max(today, as.aday + 1);
+    t_hi = as.dday - 1;
+    if (t_lo > t_hi || !beds_free(sv, as.ra, as.aday, t_lo, NULL, 0, NULL))
+        return false;
+    while (t_lo < t_hi) {
+        mid = (t_lo + t_hi + 1) / 2;
+        if (beds_free(sv, as.ra, as.aday, mid, NULL, 0, NULL)) t_lo = mid;
+        else t_hi = mid - 1;
+    }
+    t = t_lo;
+
+    // the candidates are cheapest first, so the first free one wins.
+    for (i = in.candidate_offsets[p]; i < in.candidate_offsets[p + 1]; i++) {
+        r = in.candidate_rooms[i];
+        if (r == as.ra || !beds_free(sv, r, t, as.dday, NULL, 0, NULL))
+            continue;
+        as.tday = t;
+        as.rb = r;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * extend_stay - patient p overstays by days more days. Returns false, with
+ * nothing changed, if no beds can be found for the longer stay.
+ */
+bool extend_stay(Instance &in, Solver &sv, unsigned p, unsigned days) {
+    Assignments as = sv.assignments[p];
+    unsigned stay = in.patients[p].dday - in.aday[p];
+
+    remove_patient(sv, p);
+    set_stay(in, p, stay + days);
+    as.dday = min(as.aday + stay + days, in.num_days);
+    if (!reschedule_stay(sv, p, as)) {
+        set_stay(in, p, stay);
+        place_patient(sv, p, sv.assignments[p]);
+        return false;
+    }
+    place_patient(sv, p, as);
+    return true;
+}
+
+/*
+ * discharge_early - patient p is discharged on day dday, before the end of
+ * its scheduled stay; its beds from then on are released.
+ */
+void discharge_early(Instance &in, Solver &sv, unsigned p, unsigned dday) {
+    Assignments as = sv.assignments[p];
+
+    remove_patient(sv, p);
+    set_stay(in, p, dday - as.aday);
+    as.dday = dday;
+    if (as.tday != NO_DAY && as.tday >= dday) {
+        as.tday = NO_DAY;
+        as.rb = NO_ROOM;
+    }
+    place_patient(sv, p, as);
+}
+
+/*
+ * admit_new - place the new patient p at the cheapest free room from its
+ * admission day on. A patient that finds no bed is turned away, and kept
+ * with an empty stay so that the patient ids stay dense.
+ */
+bool admit_new(Instance &in, Solver &sv, unsigned p) {
+    Assignments as;
+    int cost = min_room_cost(in, p);
+
+    if (cost != -1)
+        in.lower_bound += static_cast<unsigned>(cost) * valid_stay(in, p);
+    if (cost == -1 ||
+        !cheapest_placement(sv, p, max(in.aday[p], sv.today), as)) {
+        set_stay(in, p, 0);
+        as.aday = as.dday = in.aday[p];
+        as.tday = NO_DAY;
+        as.ra = 0;          /* empty stay; no bed needed */
+        as.rb = NO_ROOM;
+        place_patient(sv, p, as);
+        return false;
+    }
+    place_patient(sv, p, as);
+    return true;
+}
+
+/*
+ * focus_patients - the patients a repair may reschedule after the stay of
+ * patient p changed from old to nw; p and the patients that stay on the days
+ * from today on where its beds changed.
+ */
+void focus_patients(Solver &sv, unsigned p, const Assignments &old,
+                    const Assignments &nw) {
+    const Instance &in = *sv.inst;
+    unsigned q, from, to;
+
+    if (old.aday == nw.aday && old.ra == nw.ra && old.tday == nw.tday &&
+        (old.tday == NO_DAY || old.rb == nw.rb))
+        from = min(old.dday, nw.dday);
+    else
+        from = min(old.aday, nw.aday);
+    from = max(from, sv.today);
+    to = max(old.dday, nw.dday);
+
+    sv.focus.clear();
+    sv.focus.push_back(p);
+    for (q = 0; q < in.num_patients; q++) {
+        const Assignments &as = sv.assignments[q];
+        if (q != p && as.aday < to && as.dday > from && as.dday > sv.today)
+            sv.focus.push_back(q);
+    }
+}
+
+/*
+ * print_assignment - print the rooms and days of patient p.
+ */
+void print_assignment(const Solver &sv, unsigned p) {
+    const Assignments &as = sv.assignments[p];
+    *sv.out << "  " << sv.inst->patients[p].name << " [" << as.aday << ", "
+            << as.dday << ") room " << as.ra;
+    if (as.tday != NO_DAY)
+        *sv.out << ", room " << as.rb << " from day " << as.tday;
+    *sv.out << endl;
+}
+
+/*
+ * reschedule_online - process a stream of day-stamped events on top of the
+ * current schedule, in day order. Each line is one event:
+ *
+ *     <day> new <patient line as in the instance file>
+ *     <day> extend <patient id> <extra days>
+ *     <day> discharge <patient id> <discharge day>
+ *
+ * The days before the event day are fixed. The patient of the event is
+ * placed, and a short tabu search repairs only the patients staying on the
+ * changed days. The changed assignments and the time taken are reported per
+ * event. Returns false on a malformed event file.
+ */
+bool reschedule_online(Instance &in, Solver &sv, string fileName) {
+    ifstream is(fileName, ios_base::in | ios_base::binary);
+    if (!is.is_open()) {
+        cerr << fileName << ": cannot open file" << endl;
+        return false;
+    }
+    is.seekg(0, ios_base::end);
+    vector<char> text(static_cast<size_t>(is.tellg()) + 1, '\0');
+    is.seekg(0, ios_base::beg);
+    is.read(&text[0], text.size() - 1);
+    is.close();
+
+    Scanner sc(&text[0], text.size() - 1);
+    const char *word;
+    size_t len;
+    unsigned day, p = 0, q, value, n, rejected = 0, old_cost;
+    bool placed;
+    double elapsed, total_elapsed = 0;
+    vector<Assignments> before;
+    vector<unsigned> changed;
+
+    for (n = 0; !sc.at_end(); n++) {
+        day = sc.number("event day");
+        sc.word(word, len, "event type");
+        sc.check(day >= sv.today && day < in.num_days,
+                 "event day out of order");
+        if (!sc.ok()) break;
+        string kind(word, len);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        sv.today = day;
+        before = sv.assignments;
+        old_cost = sv.total_cost;
+        Assignments old;
+        if (kind == "new") {
+            p = add_patient(in, sv);
+            read_patient(sc, in, p);
+            sc.check(in.aday[p] >= day, "admission before the event day");
+            if (!sc.ok()) break;
+            add_patient_shape(in, p);
+            compute_patient_cost(in, p);
+            append_candidates(in, p);
+            placed = admit_new(in, sv, p);
+            old = sv.assignments[p];
+            old.ra = NO_ROOM;       /* the whole stay is new */
+        } else if (kind == "extend" || kind == "discharge") {
+            p = sc.number("patient id");
+            value = sc.number(kind == "extend" ? "extra days"
+                                               : "discharge day");
+            if (!sc.check(p < in.num_patients, "patient out of range")) break;
+            old = sv.assignments[p];
+            if (kind == "extend") {
+                placed = old.dday >= day && extend_stay(in, sv, p, value);
+            } else {
+                placed = value >= day && value >= old.aday &&
+                         value <= old.dday;
+                if (placed) discharge_early(in, sv, p, value);
+            }
+        } else {
+            sc.check(false, "unknown event type " + kind);
+            break;
+        }
+
+        // repair the patients around the changed days.
+        if (placed) {
+            sv.tags[p] = sv.assignments[p].dday < in.num_days
+                                ? DISCHARGED : ADMITTED;
+            focus_patients(sv, p, old, sv.assignments[p]);
+            tabu_search(sv, true, NULL);
+            sv.focus.clear();
+        } else {
+            rejected++;
+            calculate_cost(sv);
+        }
+        if (VERIFY_COST && !verify_objectives(sv, sv.total_cost)) abort();
+
+        changed.clear();
+        for (q = 0; q < in.num_patients; q++)
+            if (q >= before.size() ? placed
+                                   : !same_assignment(before[q],
+                                                      sv.assignments[q]))
+                changed.push_back(q);
+        elapsed = chrono::duration<double, micro>(chrono::steady_clock::now()
+                                                  - start).count();
+        total_elapsed += elapsed;
+
+        *sv.out << "Event " << n << ": day " << day << " " << kind << " "
+                << in.patients[p].name << (placed ? "" : " rejected")
+                << ", cost " << old_cost << " -> " << sv.total_cost << ", "
+                << changed.size() << " changes, " << fixed
+                << setprecision(0) << elapsed << " us" << endl;
+        for (q = 0; q < changed.size(); q++) print_assignment(sv, changed[q]);
+    }
+
+    if (!sc.ok()) {
+        cerr << fileName << ":" << sc.error_line << ": " << sc.error << endl;
+        return false;
+    }
+    *sv.out << "Events = " << n << ", rejected = " << rejected
+            << ", mean latency = " << fixed << setprecision(0)
+            << (n > 0 ? total_elapsed / n : 0) << " us" << endl;
+    return true;
+}
+
+/*
+ * allocate_beds - give every stay in a room one bed of that room for all its
+ * days, as bed ids of beds_room_id; bed[p][d] is NO_ROOM off the stay. The
+ * stays are taken by their first day, each taking the lowest bed free on it
+ * in the day's bitset of occupied beds; a bed free on the first day of a
+ * stay is free on all of it, since the stays holding beds started earlier.
+ * Returns false if some room-day has more patients than beds.
+ */
+bool allocate_beds(const Solver &sv, Matrix<unsigned short> &bed) {
+    const Instance &in = *sv.inst;
+    unsigned p, d, b, i, r, first, last, words = (in.num_beds + 63) / 64;
+    Matrix<uint64_t> occupied;
+    vector<pair<unsigned, unsigned>> stays;     /* (first day, patient) */
+
+    bed.resize(in.num_patients, in.num_days, NO_ROOM);
+    occupied.resize(in.num_days, max(1u, words), 0);
+    for (p = 0; p < in.num_patients; p++) {
+        const Assignments &as = sv.assignments[p];
+        if (as.aday >= as.dday) continue;
+        stays.push_back(make_pair(as.aday, 2 * p));
+        if (as.tday != NO_DAY) stays.push_back(make_pair(as.tday, 2 * p + 1));
+    }
+    sort(stays.begin(), stays.end());
+
+    for (i = 0; i < stays.size(); i++) {
+        p = stays[i].second / 2;
+        const Assignments &as = sv.assignments[p];
+        first = stays[i].first;
+        r = room_on_day(as, first);
+        last = stays[i].second % 2 == 0 && as.tday != NO_DAY ? as.tday
+                                                             : as.dday;
+        const uint64_t *used = occupied[first];
+        for (b = in.room_first_bed[r];
+             b < in.room_first_bed[r] + in.rooms[r].capacity &&
+             (used[b / 64] >> (b % 64) & 1); b++);
+        if (b == in.room_first_bed[r] + in.rooms[r].capacity ||
+            in.beds_room_id[b] != r)
+            return false;
+        for (d = first; d < last; d++) {
+            occupied[d][b / 64] |= 1ull << (b % 64);
+            bed[p][d] = b;
+        }
+    }
+    return true;
+}
+
+/*
+ * read_solution - read the assignments as of a solution file in the compact
+ * format, for a diff against it. Returns false on a malformed file.
+ */
+bool read_solution(string fileName, vector<Assignments> &as) {
+    ifstream is(fileName, ios_base::in | ios_base::binary);
+    if (!is.is_open()) {
+        cerr << fileName << ": cannot open file" << endl;
+        return false;
+    }
+    is.seekg(0, ios_base::end);
+    vector<char> text(static_cast<size_t>(is.tellg()) + 1, '\0');
+    is.seekg(0, ios_base::beg);
+    is.read(&text[0], text.size() - 1);
+    is.close();
+
+    Scanner sc(&text[0], text.size() - 1);
+    const char *word;
+    size_t len;
+    unsigned i, p, n, num_patients;
+    unsigned *fields[5];
+
+    sc.word(word, len, "header label");
+    sc.word(word, len, "solution format");
+    sc.check(same_word(word, len, "compact"), "expected a compact solution");
+    sc.skip_line();
+    sc.word(word, len, "header label");
+    num_patients = sc.number("number of patients");
+    sc.word(word, len, "header label");
+    sc.number("number of days");
+    sc.word(word, len, "header label");
+    sc.number("cost");
+    sc.word(word, len, "header label");
+    n = sc.number("number of patients listed");
+    if (!sc.check(n <= num_patients, "more patients listed than exist")) {
+        cerr << fileName << ":" << sc.error_line << ": " << sc.error << endl;
+        return false;
+    }
+
+    as.assign(num_patients, Assignments());
+    for (i = 0; i < n && sc.ok(); i++) {
+        p = sc.number("patient");
+        if (!sc.check(p < num_patients, "patient out of range")) break;
+        Assignments &a = as[p];
+        fields[0] = &a.ra;
+        fields[1] = &a.aday;
+        fields[2] = &a.tday;
+        fields[3] = &a.dday;
+        fields[4] = &a.rb;
+        for (unsigned f = 0; f < 5; f++) {
+            sc.word(word, len, "assignment field");
+            if (same_word(word, len, "-")) {
+                *fields[f] = f == 0 || f == 4 ? NO_ROOM : NO_DAY;
+                continue;
+            }
+            *fields[f] = 0;
+            for (size_t c = 0; c < len; c++) {
+                sc.check(word[c] >= '0' && word[c] <= '9',
+                         "expected a number or -");
+                *fields[f] = *fields[f] * 10 + (word[c] - '0');
+            }
+        }
+        a.cost = 0;
+    }
+    if (!sc.ok()) {
+        cerr << fileName << ":" << sc.error_line << ": " << sc.error << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * print_solution - print out the algorithm solution in OUTPUT_FORMAT, built
+ * in one buffer and written at once; as text with the beds if PRINT_BEDS, or
+ * compact. The diff format lists the patients changed from baseline.
+ */
+unsigned print_solution(const Solver &sv, const vector<Assignments> &baseline) {
+    const Instance &in = *sv.inst;
+    unsigned p, d;
+    string buf;
+
+    if (OUTPUT_FORMAT == COMPACT_OUTPUT) {
+        append_compact(buf, sv, sv.assignments, sv.total_cost, NULL);
+    } else if (OUTPUT_FORMAT == DIFF_OUTPUT) {
+        append_compact(buf, sv, sv.assignments, sv.total_cost, &baseline);
+    } else {
+        append_text(buf, sv, NULL);
+    }
+    if (OUTPUT_FORMAT == TEXT_OUTPUT && PRINT_BEDS) {
+        Matrix<unsigned short> bed;
+        if (!allocate_beds(sv, bed)) {
+            sv.out->write(buf.data(), buf.size());
+            *sv.out << "Failed to allocate beds!" << endl;
+            return 1;
+        }
+        buf += "Beds:\n";
+        for (p = 0; p < in.num_patients; p++) {
+            buf += "Pat_";
+            append_number(buf, p, UINT_MAX);
+            buf += "  ";
+            for (d = 0; d < in.num_days; d++) {
+                append_number(buf, bed[p][d], NO_ROOM);
+                buf += ' ';
+            }
+            buf += '\n';
+        }
+    }
+    sv.out->write(buf.data(), buf.size());
+    return 0;
+}
+
+/*
+ * print_cost_breakdown - print the running cost of each component, with the
+ * number of transfers and of delayed patients and days.
+ */
+void print_cost_breakdown(const Solver &sv) {
+    const Instance &in = *sv.inst;
+    unsigned p, k, transfers = 0, delayed = 0, delay_days = 0;
+    for (p = 0; p < in.num_patients; p++) {
+        const Assignments &as = sv.assignments[p];
+        if (as.tday != NO_DAY) transfers++;
+        if (as.aday > in.aday[p]) {
+            delayed++;
+            delay_days += as.aday - in.aday[p];
+        }
+    }
+    for (k = 0; k < NUM_COST_PARTS; k++)
+        *sv.out << COST_PART_NAMES[k] << " Cost = "
+                << sv.objectives.parts[k] << endl;
+    *sv.out << "Transfers = " << transfers << endl
+            << "Delays = " << delayed << " patients, " << delay_days
+            << " days" << endl;
+}
+
+/*
+ * generate_initial - generate the initial solution in INIT_MODE and compute
+ * its cost. Returns false if some patient could not be placed.
+ */
+bool generate_initial(Solver &sv) {
+    bool generated;
+    PHASE_TIMER(PHASE_INIT);
+    if (INIT_MODE == RANDOM_INIT) {
+        generate_ini_solution(sv);
+        generated = load_assignments(sv);
+        // arrange_patients() books beds_tempo only; take the beds.
+        if (generated) rebuild_occupancy(sv);
+    } else
+        generated = generate_greedy_solution(sv);
+    if (generated) calculate_cost(sv);
+    return generated;
+}
+
+/* Names of the stop reasons, for the output. */
+const char *const STOP_NAMES[] = {"none", "iterations", "idle", "time", "gap"};
+
+/*
+ * search - improve the initial solution by tabu search; by day windows first
+ * if WINDOW_DAYS is set, then in parallel with NUM_THREADS threads, else in
+ * s0 and then in s1. The final solution is streamed out as the last
+ * incumbent. Returns the number of iterations.
+ */
+unsigned search(Solver &sv) {
+    unsigned s0, s1, sw = 0;
+    if (WINDOW_DAYS > 0 && WINDOW_DAYS < sv.inst->num_days) {
+        sw = window_search(sv);
+        *sv.out << "window iterations = " << sw << ", cost = "
+                << sv.total_cost << endl;
+    }
+    if (NUM_THREADS > 1) {
+        s0 = parallel_tabu_search(sv, NUM_THREADS);
+        *sv.out << "parallel iterations = " << s0 << endl;
+    } else {
+        // search s0 first, then refine the best s0 solution in s1.
+        s0 = tabu_search(sv, false, NULL);
+        *sv.out << "s0 iterations = " << s0 << ", stop = "
+                << STOP_NAMES[sv.stop] << endl;
+        s1 = tabu_search(sv, true, NULL);
+        *sv.out << "s1 iterations = " << s1 << ", stop = "
+                << STOP_NAMES[sv.stop] << endl;
+        s0 += s1;
+    }
+    stream_incumbent(sv, static_cast<int>(sv.total_cost), sv.assignments,
+                     true);
+    return s0 + sw;
+}
+
+/*
+ * bench_instance - benchmark the solver on instance file fileName, once per
+ * seed from seed to seed + num_seeds - 1, appending one run per seed. The
+ * instance is prepared once; every run solves it from scratch. The runs
+ * report to log, with their solutions if print is set. Instance and solvers
+ * are local, so any number of instances can be solved at once.
+ */
+bool bench_instance(string fileName, unsigned num_seeds, uint64_t seed,
+                    vector<BenchRuns> &runs, ostream &log, bool print) {
+    Instance in;
+    BenchRuns run;
+    unsigned k;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!read_instance(in, fileName)) return false;
+    run.parse_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    compute_overlap(in);
+    run.overlap_ms = elapsed_ms(start);
+    start = chrono::steady_clock::now();
+    compute_cost(in);
+    compute_candidates(in);
+    run.cost_ms = elapsed_ms(start);
+    compute_lower_bound(in);
+
+    run.instance = fileName;
+    run.patients = in.num_patients;
+    run.rooms = in.num_rooms;
+    run.days = in.num_days;
+    run.lower_bound = in.lower_bound;
+    for (k = 0; k < num_seeds; k++) {
+        Solver sv;
+        run.seed = seed + k;
+        init_solver(sv, in, run.seed);
+        sv.out = &log;
+        log << fileName << ": Seed = " << run.seed << endl;
+
+        start = chrono::steady_clock::now();
+        run.feasible = generate_initial(sv);
+        run.init_ms = elapsed_ms(start);
+        run.initial_cost = run.feasible ? sv.total_cost : 0;
+        run.iterations = 0;
+        run.search_ms = 0;
+        if (run.feasible) {
+            start = chrono::steady_clock::now();
+            run.iterations = search(sv);
+            run.search_ms = elapsed_ms(start);
+        }
+        run.final_cost = run.feasible ? sv.total_cost : 0;
+        runs.push_back(run);
+        if (print && run.feasible) {
+            print_solution(sv, vector<Assignments>());
+            log << "Total Cost = " << sv.total_cost << endl;
+        } else if (print)
+            log << "Failed to generate an initial solution!" << endl;
+    }
+    return true;
+}
+
+/*
+ * bench_gap - the gap of the final cost of run r above its lower bound,
+ * relative to the bound; 0 without a bound.
+ */
+double bench_gap(const BenchRuns &r) {
+    return r.lower_bound > 0 ? (static_cast<double>(r.final_cost) -
+                                r.lower_bound) / r.lower_bound : 0;
+}
+
+/*
+ * write_bench_csv - write the benchmark runs as CSV, one row per run. The
+ * costs and the gap of an infeasible run are empty fields.
+ */
+void write_bench_csv(ostream &os, const vector<BenchRuns> &runs) {
+    unsigned i;
+    os << "instance,seed,patients,rooms,days,parse_ms,overlap_ms,cost_ms,"
+          "init_ms,search_ms,feasible,initial_cost,iterations,"
+          "iterations_per_sec,final_cost,lower_bound,gap" << endl;
+    os << fixed << setprecision(3);
+    for (i = 0; i < runs.size(); i++) {
+        const BenchRuns &r = runs[i];
+        os << '"' << r.instance << '"' << "," << r.seed << "," << r.patients
+           << "," << r.rooms << "," << r.days << "," << r.parse_ms << ","
+           << r.overlap_ms << "," << r.cost_ms << "," << r.init_ms << ","
+           << r.search_ms << "," << r.feasible << ",";
+        if (r.feasible) os << r.initial_cost;
+        os << "," << r.iterations << ","
+           << (r.search_ms > 0 ? r.iterations * 1000.0 / r.search_ms : 0)
+           << ",";
+        if (r.feasible) os << r.final_cost;
+        os << "," << r.lower_bound << ",";
+        if (r.feasible) os << bench_gap(r);
+        os << endl;
+    }
+}
+
+/*
+ * write_bench_json - write the benchmark runs as a JSON array of objects. The
+ * costs and the gap of an infeasible run are null.
+ */
+void write_bench_json(ostream &os, const vector<BenchRuns> &runs) {
+    unsigned i, c;
+    os << "[" << endl << fixed << setprecision(3);
+    for (i = 0; i < runs.size(); i++) {
+        const BenchRuns &r = runs[i];
+        os << "  {\"instance\": \"";
+        for (c = 0; c < r.instance.size(); c++) {
+            if (r.instance[c] == '"' || r.instance[c] == '\\') os << '\\';
+            os << r.instance[c];
+        }
+        os << "\", \"seed\": " << r.seed << ", \"patients\": " << r.patients
+           << ", \"rooms\": " << r.rooms << ", \"days\": " << r.days
+           << ", \"parse_ms\": " << r.parse_ms
+           << ", \"overlap_ms\": " << r.overlap_ms
+           << ", \"cost_ms\": " << r.cost_ms << ", \"init_ms\": " << r.init_ms
+           << ", \"search_ms\": " << r.search_ms
+           << ", \"feasible\": " << (r.feasible ? "true" : "false")
+           << ", \"initial_cost\": ";
+        if (r.feasible) os << r.initial_cost;
+        else os << "null";
+        os << ", \"iterations\": " << r.iterations
+           << ", \"iterations_per_sec\": "
+           << (r.search_ms > 0 ? r.iterations * 1000.0 / r.search_ms : 0)
+           << ", \"final_cost\": ";
+        if (r.feasible) os << r.final_cost;
+        else os << "null";
+        os << ", \"lower_bound\": " << r.lower_bound << ", \"gap\": ";
+        if (r.feasible) os << bench_gap(r);
+        else os << "null";
+        os << "}" << (i + 1 < runs.size() ? "," : "") << endl;
+    }
+    os << "]" << endl;
+}
+
+/*
+ * write_bench_report - write the runs to outPath, as JSON if it ends in .json
+ * and as CSV otherwise; to stdout if empty.
+ */
+bool write_bench_report(string outPath, const vector<BenchRuns> &runs) {
+    bool json = outPath.size() >= 5 &&
+                outPath.compare(outPath.size() - 5, 5, ".json") == 0;
+    if (outPath.empty()) {
+        write_bench_csv(cout, runs);
+        return true;
+    }
+    ofstream os(outPath, ofstream::out);
+    if (!os.is_open()) {
+        cerr << outPath << ": cannot open file" << endl;
+        return false;
+    }
+    if (json) write_bench_json(os, runs);
+    else write_bench_csv(os, runs);
+    return true;
+}
+
+/*
+ * list_instances - the .pasu files under directory dir, in path order.
+ */
+bool list_instances(string dir, vector<string> &files) {
+    error_code ec;
+    for (filesystem::recursive_directory_iterator it(dir, ec), end;
+         !ec && it != end; it.increment(ec))
+        if (it->path().extension() == ".pasu")
+            files.push_back(it->path().string());
+    if (ec) {
+        cerr << dir << ": " << ec.message() << endl;
+        return false;
+    }
+    sort(files.begin(), files.end());
+    return true;
+}
+
+/*
+ * run_benchmark - benchmark the solver on every .pasu file under directory
+ * dir (for example one subdirectory per instance family), in path order, with
+ * num_seeds seeds each. The runs are written to outPath by
+ * write_bench_report().
+ */
+bool run_benchmark(string dir, unsigned num_seeds, uint64_t seed,
+                   string outPath) {
+    vector<string> files;
+    vector<BenchRuns> runs;
+    unsigned i;
+    bool ok = true;
+
+    if (!list_instances(dir, files)) return false;
+    for (i = 0; i < files.size(); i++) {
+        cerr << "bench " << files[i] << endl;
+        if (!bench_instance(files[i], num_seeds, seed, runs, outFile, false))
+            ok = false;
+    }
+    return write_bench_report(outPath, runs) && ok;
+}
+
+/*
+ * batch_worker - worker w of a batch; solves the jobs it takes from the pool
+ * until none are left.
+ */
+void batch_worker(WorkQueues *pool, unsigned w, vector<BatchJobs> *jobs,
+                  unsigned num_seeds, uint64_t seed) {
+    unsigned j;
+    while (pool->pop(w, j)) {
+        BatchJobs &job = (*jobs)[j];
+        job.ok = bench_instance(job.instance, num_seeds, seed, job.runs,
+                                job.log, true);
+    }
+    merge_stats();
+}
+
+/*
+ * run_batch - solve many instances in one process, num_jobs at a time on a
+ * work-stealing pool. list is a directory, searched for .pasu files as by
+ * run_benchmark(), or a file of instance paths, one per line. The largest
+ * files are dealt first, so that the long solves start early. Every instance
+ * is solved in its own context; the output and solutions of all instances
+ * go to the output in list order, and one row per run to the report at
+ * outPath, as by write_bench_report().
+ */
+bool run_batch(string list, unsigned num_jobs, unsigned num_seeds,
+               uint64_t seed, string outPath) {
+    vector<string> files;
+    vector<unsigned> order;
+    vector<thread> threads;
+    vector<BenchRuns> runs;
+    unsigned i, w;
+    bool ok = true;
+    error_code ec;
+
+    if (filesystem::is_directory(list, ec)) {
+        if (!list_instances(list, files)) return false;
+    } else {
+        ifstream is(list);
+        string line;
+        if (!is.is_open()) {
+            cerr << list << ": cannot open file" << endl;
+            return false;
+        }
+        while (getline(is, line)) {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#') files.push_back(line);
+        }
+    }
+
+    vector<BatchJobs> jobs(files.size());
+    vector<uintmax_t> sizes(files.size());
+    for (i = 0; i < files.size(); i++) {
+        jobs[i].instance = files[i];
+        jobs[i].ok = false;
+        sizes[i] = filesystem::file_size(files[i], ec);
+        if (ec) sizes[i] = 0;
+        order.push_back(i);
+    }
+    stable_sort(order.begin(), order.end(),
+                [&sizes](unsigned a, unsigned b) {
+                    return sizes[a] > sizes[b];
+                });
+
+    num_jobs = max(1u, min(num_jobs, static_cast<unsigned>(files.size())));
+    WorkQueues pool(num_jobs, order);
+    for (w = 0; w < num_jobs; w++)
+        threads.push_back(thread(batch_worker, &pool, w, &jobs, num_seeds,
+                                 seed));
+    for (w = 0; w < num_jobs; w++) threads[w].join();
+
+    for (i = 0; i < jobs.size(); i++) {
+        outFile << "Instance = " << jobs[i].instance << endl
+                << jobs[i].log.str();
+        if (!jobs[i].ok) {
+            outFile << "Failed to prepare data!" << endl;
+            ok = false;
+        }
+        runs.insert(runs.end(), jobs[i].runs.begin(), jobs[i].runs.end());
+    }
+    return write_bench_report(outPath, runs) && ok;
+}
+
+/*
+ * write_synthetic - write a random instance of size sz into text, in the
+ * instance file format; the same instance for the same seed. There is one
+ * department per 40 rooms with two specialisms each, rooms of 1 to 6 beds
+ * with any gender policy and features, and stays of 1 to 6 days, some with
+ * overstay variability, admission limits and room preferences.
+ */
+void write_synthetic(string &text, const MicroSizes &sz, uint64_t seed) {
+    static const unsigned capacities[] = {1, 2, 2, 4, 4, 6};
+    static const char *const policies[] = {"SG", "Fe", "Ma", "-", "SG"};
+    static const char *const ages[] = {"-", "-", ">= 10", "<= 90"};
+    static const unsigned variability[] = {0, 0, 0, 1, 2};
+    static const unsigned preferred[] = {1, 2, 4};
+    const unsigned num_departments = 1 + sz.rooms / 40;
+    const unsigned num_specialisms = 2 * num_departments;
+    Rng rng(seed);
+    unsigned d, r, p, f, n, k, a;
+    ostringstream os;
+
+    os << "PASU instance: synthetic " << seed << "\nDepartments: "
+       << num_departments << "\nRooms: " << sz.rooms << "\nFeatures: "
+       << sz.features << "\nPatients: " << sz.patients << "\nSpecialisms: "
+       << num_specialisms << "\nHorizon: " << sz.days << "\n\n";
+
+    os << "DEPARTMENTS (name, age limits, main specialisms, aux "
+          "specialisms):\n";
+    for (d = 0; d < num_departments; d++) {
+        os << "Dep_" << d << " " << ages[rng.below(4)] << " (" << d << ","
+           << d + num_departments << ") ";
+        if (num_departments > 1 && rng.below(10) < 7)
+            os << "(" << (d + 1) % num_departments << ")\n";
+        else
+            os << "-\n";
+    }
+
+    os << "\nROOMS (name, capacity, department, gender policy, features):\n";
+    for (r = 0; r < sz.rooms; r++) {
+        os << "R_" << r << " " << capacities[rng.below(6)] << " "
+           << r % num_departments << " " << policies[rng.below(5)] << " ";
+        for (f = n = 0; f < sz.features; f++)
+            if (rng.below(2) == 0) os << (n++ == 0 ? "(" : ",") << f;
+        os << (n > 0 ? ")\n" : "-\n");
+    }
+
+    os << "\nPATIENTS (name, age, gender, <registration, admission, "
+          "discharge, variability, max admission>, treatment, preferred "
+          "capacity, preferred properties):\n";
+    for (p = 0; p < sz.patients; p++) {
+        a = rng.below(sz.days);
+        os << "Pat_" << p << " " << 20 + rng.below(61) << " "
+           << (rng.below(2) == 0 ? "Ma" : "Fe") << " <"
+           << a - min(a, rng.below(4)) << ", " << a << ", "
+           << a + 1 + rng.below(6) << ", " << variability[rng.below(5)]
+           << ", ";
+        if (rng.below(2) == 0) os << "*";
+        else os << "<=" << min(sz.days - 1, a + rng.below(4));
+        os << "> " << rng.below(num_specialisms) << " ";
+        if (rng.below(2) == 0) os << "* ";
+        else os << "<=" << preferred[rng.below(3)] << " ";
+        n = sz.features > 0 ? rng.below(3) : 0;
+        for (k = 0; k < n; k++)
+            os << (k == 0 ? "(" : ",") << rng.below(sz.features)
+               << (rng.below(20) == 0 ? "n" : "p");
+        os << (n > 0 ? ")\n" : "-\n");
+    }
+    os << "END.\n";
+    text = os.str();
+}
+
+/*
+ * time_kernel - time operation op of kernel, run in doubling batches until
+ * MICRO_MS milliseconds have passed, with the allocations it made if they
+ * are counted.
+ */
+template <class Operation>
+MicroRuns time_kernel(const char *kernel, Operation op) {
+    MicroRuns run = {kernel, 0, 0, 0};
+    uint64_t i, batch = 1, allocations = thread_allocations;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    while (elapsed_ms(start) < MICRO_MS) {
+        for (i = 0; i < batch; i++) op();
+        run.ops += batch;
+        batch *= 2;
+    }
+    run.ns = elapsed_ms(start) * 1e6;
+    run.allocations = thread_allocations - allocations;
+    return run;
+}
+
+/*
+ * write_micro_csv - write the microbenchmark runs as CSV, one row per
+ * kernel with the instance size, in nanoseconds and allocations per
+ * operation; the allocations are left empty unless counted.
+ */
+void write_micro_csv(ostream &os, const MicroSizes &sz,
+                     const vector<MicroRuns> &runs) {
+    unsigned i;
+    os << "kernel,patients,rooms,days,features,ops,ns_per_op,allocs_per_op"
+       << endl;
+    for (i = 0; i < runs.size(); i++) {
+        const MicroRuns &r = runs[i];
+        os << r.kernel << "," << sz.patients << "," << sz.rooms << ","
+           << sz.days << "," << sz.features << "," << r.ops << "," << fixed
+           << setprecision(1) << r.ns / r.ops << ",";
+        if (COUNT_ALLOCATIONS)
+            os << setprecision(2)
+               << static_cast<double>(r.allocations) / r.ops;
+        os << endl;
+    }
+}
+
+/*
+ * run_micro - microbenchmark the hot kernels on a synthetic instance of size
+ * sz; per call compute_overlap() and compute_cost(), the free bed check of
+ * arrange_patients() for a stay in one of its candidate rooms, the search of
+ * one tabu search neighborhood, one tabu move (the search, then the best
+ * move made tabu and applied), and print_solution() to a discarding stream.
+ * The report goes to outPath as CSV, to stdout if empty.
+ */
+bool run_micro(const MicroSizes &sz, uint64_t seed, string outPath) {
+    Instance in;
+    Solver sv;
+    Neighborhoods nb;
+    vector<MicroRuns> runs;
+    vector<Assignments> stays, baseline;
+    Assignments as;
+    string text;
+    unsigned p, a, k = 0;
+    volatile unsigned sink;
+    ostream discard(NULL);
+
+    write_synthetic(text, sz, seed);
+    vector<char> buf(text.begin(), text.end());
+    buf.push_back('\0');
+    if (!parse_instance(in, buf, "synthetic instance")) return false;
+    runs.push_back(time_kernel("compute_overlap",
+                               [&]() { compute_overlap(in); }));
+    runs.push_back(time_kernel("compute_cost", [&]() { compute_cost(in); }));
+    compute_candidates(in);
+    compute_lower_bound(in);
+
+    init_solver(sv, in, seed);
+    sv.out = &discard;
+    if (!generate_initial(sv)) {
+        cerr << "synthetic instance: no initial solution; too few beds?"
+             << endl;
+        return false;
+    }
+
+    // the stays checked, in a random candidate room, against the beds taken.
+    for (p = 0; p < in.num_patients; p++) {
+        a = in.candidate_offsets[p + 1] - in.candidate_offsets[p];
+        if (a == 0) continue;
+        as = sv.assignments[p];
+        as.ra = in.candidate_rooms[in.candidate_offsets[p] +
+                                   sv.rng.below(a)];
+        stays.push_back(as);
+    }
+    update_tempo_room_capacity(sv);
+    if (!stays.empty())
+        runs.push_back(time_kernel("room_free", [&]() {
+            const Assignments &stay = stays[k];
+            sink = sv.bed_trees_tempo.min_free(stay.ra, stay.aday, stay.dday);
+            if (++k == stays.size()) k = 0;
+        }));
+
+    NeighborhoodSearch neighborhood = neighborhood_search(in, true);
+    nb.current_cost = nb.best_cost = static_cast<int>(sv.total_cost);
+    nb.iter = 0;
+    clear_tabu(sv);
+    runs.push_back(time_kernel("tabu_evaluate",
+                               [&]() { sink = neighborhood(sv, nb); }));
+    runs.push_back(time_kernel("tabu_move", [&]() {
+        if (neighborhood(sv, nb)) {
+            make_tabu(sv, nb.best, TABU_TENURE);
+            apply_move(sv, nb.best);
+            nb.current_cost += nb.best.delta;
+            nb.best_cost = min(nb.best_cost, nb.current_cost);
+        }
+        nb.iter++;
+        sv.tabu_clock++;
+    }));
+
+    calculate_cost(sv);
+    runs.push_back(time_kernel("print_solution",
+                               [&]() { print_solution(sv, baseline); }));
+
+    if (outPath.empty()) {
+        write_micro_csv(cout, sz, runs);
+        return true;
+    }
+    ofstream os(outPath, ofstream::out);
+    if (!os.is_open()) {
+        cerr << outPath << ": cannot open file" << endl;
+        return false;
+    }
+    write_micro_csv(os, sz, runs);
+    return true;
+}
+
+/*
+ * parse_number - value as a decimal number in [lo, hi], all of it; no sign,
+ * no spaces. Throws invalid_argument or out_of_range otherwise.
+ */
+uint64_t parse_number(const string &value, uint64_t lo, uint64_t hi) {
+    size_t pos = 0;
+    if (value.empty() || !isdigit(static_cast<unsigned char>(value[0])))
+        throw invalid_argument(value);
+    unsigned long long n = stoull(value, &pos);
+    if (pos != value.size()) throw invalid_argument(value);
+    if (n < lo || n > hi) throw out_of_range(value);
+    return n;
+}
+
+/*
+ * parse_unsigned - value as an unsigned number of at least lo, as by
+ * parse_number().
+ */
+unsigned parse_unsigned(const string &value, unsigned lo = 0,
+                        unsigned hi = UINT_MAX) {
+    return static_cast<unsigned>(parse_number(value, lo, hi));
+}
+
+/*
+ * parse_real - value as a real number, all of it.
+ */
+double parse_real(const string &value) {
+    size_t pos = 0;
+    if (value.empty() || isspace(static_cast<unsigned char>(value[0])))
+        throw invalid_argument(value);
+    double x = stod(value, &pos);
+    if (pos != value.size()) throw invalid_argument(value);
+    return x;
+}
+
+/*
+ * parse_flag - value as a flag; 1, true or yes, or 0, false or no.
+ */
+bool parse_flag(const string &value) {
+    if (value == "1" || value == "true" || value == "yes") return true;
+    if (value == "0" || value == "false" || value == "no") return false;
+    throw invalid_argument(value);
+}
+
+/*
+ * parse_choice - the index of value among the num_names names; throws
+ * invalid_argument if it is none of them.
+ */
+unsigned parse_choice(const string &value, const char *const names[],
+                      unsigned num_names) {
+    unsigned i;
+    for (i = 0; i < num_names; i++)
+        if (value == names[i]) return i;
+    throw invalid_argument(value);
+}
+
+/*
+ * read_sizes - read the microbenchmark instance size from value, as
+ * "<patients>,<rooms>,<days>[,<features>]"; 6 room features by default.
+ * Throws invalid_argument or out_of_range on a malformed size.
+ */
+void read_sizes(const string &value, MicroSizes &sz) {
+    unsigned *fields[4] = {&sz.patients, &sz.rooms, &sz.days, &sz.features};
+    size_t at = 0, comma;
+    unsigned i;
+
+    sz.features = 6;
+    for (i = 0; i < 4 && at <= value.size(); i++) {
+        comma = value.find(',', at);
+        if (comma == string::npos) comma = value.size();
+        *fields[i] = parse_unsigned(value.substr(at, comma - at),
+                                    i < 3 ? 1 : 0);
+        at = comma + 1;
+    }
+    if (i < 3 || at <= value.size()) throw invalid_argument(value);
+}
+
+/*
+ * RunOptions - the options of a run that are not solver parameters; what to
+ * solve, and where the results go.
+ */
+struct RunOptions {
+    string filename;                    /* instance file */
+    uint64_t seed;                      /* first random seed */
+    bool seeded;                        /* whether the seed was given */
+    unsigned num_seeds;                 /* seeds per instance, 0 if not given */
+    unsigned num_jobs;                  /* batch instances at once */
+    string events;                      /* online event file */
+    string bench_dir;                   /* benchmark instance directory */
+    string bench_out;                   /* benchmark report */
+    string cache;                       /* instance cache file */
+    string batch;                       /* batch instance list */
+    string baseline_file;               /* baseline solution, diff format */
+    string out;                         /* result file, stdout if empty */
+    MicroSizes micro;                   /* microbenchmark size, if patients */
+};
+
+/*
+ * set_option - set option name (without the leading "--") to value; a solver
+ * parameter, which the penalty weights are too, or an option of the run.
+ * The room weights are folded into total_patient_room_cost when the
+ * instance is prepared, after all options are set. Numbers must be whole
+ * and in range, and choices and flags one of their names. Returns false for
+ * an unknown name or a malformed value.
+ */
+bool set_option(RunOptions &opt, const string &name, const string &value) {
+    static const char *const init_names[] = {"greedy", "random"};
+    static const char *const pick_names[] = {"random", "worst"};
+    static const char *const format_names[] = {"text", "compact", "diff"};
+    try {
+        if (name == "property-weight")
+            PREFERRED_PROPERTY_WEIGHT = parse_unsigned(value);
+        else if (name == "preference-weight")
+            PREFERENCE_WEIGHT = parse_unsigned(value);
+        else if (name == "specialism-weight")
+            SPECIALISM_WEIGHT = parse_unsigned(value);
+        else if (name == "gender-weight") GENDER_WEIGHT = parse_unsigned(value);
+        else if (name == "transfer-weight")
+            TRANSFER_WEIGHT = parse_unsigned(value);
+        else if (name == "delay-weight") DELAY_WEIGHT = parse_unsigned(value);
+        else if (name == "risk-weight")
+            OVERCROWD_RISK_WEIGHT = parse_unsigned(value);
+        else if (name == "tenure")
+            TABU_TENURE = parse_unsigned(value, 1, MAX_TENURE);
+        else if (name == "max-iterations")
+            MAX_ITERATIONS = parse_unsigned(value);
+        else if (name == "max-idle")
+            MAX_IDLE_ITERATIONS = parse_unsigned(value);
+        else if (name == "repair-iterations")
+            REPAIR_ITERATIONS = parse_unsigned(value);
+        else if (name == "repair-idle")
+            REPAIR_IDLE_ITERATIONS = parse_unsigned(value);
+        else if (name == "time-limit") TIME_LIMIT_MS = parse_unsigned(value);
+        else if (name == "max-restarts") MAX_RESTARTS = parse_unsigned(value);
+        else if (name == "gap") GAP_LIMIT = parse_real(value);
+        else if (name == "incumbent") INCUMBENT_FILE = value;
+        else if (name == "incumbent-interval")
+            INCUMBENT_INTERVAL_MS = parse_unsigned(value);
+        else if (name == "threads") NUM_THREADS = parse_unsigned(value, 1);
+        else if (name == "migration-interval")
+            MIGRATION_INTERVAL = parse_unsigned(value, 1);
+        else if (name == "init")
+            INIT_MODE = static_cast<InitMode>(parse_choice(value, init_names,
+                                                           2));
+        else if (name == "pick")
+            PICK_MODE = static_cast<PickMode>(parse_choice(value, pick_names,
+                                                           2));
+        else if (name == "first-improvement")
+            FIRST_IMPROVEMENT = parse_flag(value);
+        else if (name == "sample") SWAP_SAMPLE = parse_unsigned(value);
+        else if (name == "windows") WINDOW_DAYS = parse_unsigned(value);
+        else if (name == "format")
+            OUTPUT_FORMAT = static_cast<OutputFormat>(
+                parse_choice(value, format_names, 3));
+        else if (name == "verify") VERIFY_COST = parse_flag(value);
+        else if (name == "beds") PRINT_BEDS = parse_flag(value);
+#ifdef PASU_INSTRUMENT
+        else if (name == "stats-interval")
+            STATS_INTERVAL = parse_unsigned(value);
+#endif
+        else if (name == "input") opt.filename = value;
+        else if (name == "out") opt.out = value;
+        else if (name == "seed") {
+            opt.seed = parse_number(value, 0, UINT64_MAX);
+            opt.seeded = true;
+        } else if (name == "seeds") opt.num_seeds = parse_unsigned(value, 1);
+        else if (name == "jobs") opt.num_jobs = parse_unsigned(value);
+        else if (name == "events") opt.events = value;
+        else if (name == "bench") opt.bench_dir = value;
+        else if (name == "bench-out") opt.bench_out = value;
+        else if (name == "cache") opt.cache = value;
+        else if (name == "batch") opt.batch = value;
+        else if (name == "baseline") opt.baseline_file = value;
+        else if (name == "micro") read_sizes(value, opt.micro);
+        else if (name == "micro-ms") MICRO_MS = parse_unsigned(value);
+        else return false;
+    } catch (const logic_error &) {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * read_config - set the options of config file fileName, one per line as
+ *
+ *     <name> = <value>
+ *
+ * with the names of the command line options; "#" starts a comment. Options
+ * given on the command line after --config override those of the file.
+ * Returns false, naming the line, on an unknown option or a bad value.
+ */
+bool read_config(RunOptions &opt, string fileName) {
+    ifstream is(fileName);
+    if (!is.is_open()) {
+        cerr << fileName << ": cannot open file" << endl;
+        return false;
+    }
+    string line;
+    unsigned n;
+    for (n = 1; getline(is, line); n++) {
+        size_t hash = line.find('#'), eq;
+        if (hash != string::npos) line.erase(hash);
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+        eq = line.find('=');
+        string name = line.substr(0, eq), value;
+        if (eq != string::npos) value = line.substr(eq + 1);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        if (eq == string::npos || !set_option(opt, name, value)) {
+            cerr << fileName << ":" << n << ": unknown option or bad value "
+                 << name << " = " << value << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * print_usage - print how to run the program, to the error output.
+ */
+void print_usage(const char *program) {
+    cerr << "usage: " << program << " [options] <instance file>\n"
+            "       " << program << " [options] --bench <directory>\n"
+            "       " << program << " [options] --batch <directory or list>\n"
+            "       " << program << " [options] --micro <P,R,D[,F]>\n"
+            "Options are \"--<name> <value>\", or read from a file by\n"
+            "\"--config <file>\"; the results go to stdout unless \"--out "
+            "<file>\"." << endl;
+}
+
+/*
+ * main - the main routine of the program. Every option is "--<name> <value>"
+ * as by set_option(), or a flag; a bare argument is the instance file.
+ */
+int main(int argc, char *argv[]) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int i;
+    RunOptions opt;
+    vector<Assignments> baseline;
+
+    opt.seed = static_cast<uint64_t>(time(0));
+    opt.seeded = false;
+    opt.num_seeds = 0;
+    opt.num_jobs = thread::hardware_concurrency();
+    opt.micro.patients = 0;
+    for (i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--first-improvement" || arg == "--verify" ||
+            arg == "--beds") {
+            set_option(opt, arg.substr(2), "1");
+        } else if (arg == "--config" && i + 1 < argc) {
+            if (!read_config(opt, argv[++i])) return 1;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            opt.filename = arg;
+        } else if (i + 1 >= argc) {
+            cerr << arg << ": missing value" << endl;
+            return 1;
+        } else if (!set_option(opt, arg.substr(2), argv[++i])) {
+            cerr << arg << " " << argv[i] << ": unknown option or bad value"
+                 << endl;
+            return 1;
+        }
+    }
+
+
+    if (!opt.out.empty()) {
+        resultFile.open(opt.out, ofstream::out);
+        if (!resultFile.is_open()) {
+            cerr << opt.out << ": cannot open file" << endl;
+            return 1;
+        }
+        outFile.rdbuf(resultFile.rdbuf());
+    }
+    if (opt.filename.empty() && opt.micro.patients == 0 &&
+        opt.bench_dir.empty() && opt.batch.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (opt.micro.patients > 0)
+        return run_micro(opt.micro, opt.seeded ? opt.seed : 1,
+                         opt.bench_out) ? 0 : 1;
+    if (!opt.bench_dir.empty()) {
+        bool ok = run_benchmark(opt.bench_dir,
+                                opt.num_seeds > 0 ? opt.num_seeds : 5,
+                                opt.seeded ? opt.seed : 1, opt.bench_out);
+        print_stats(outFile);
+        return ok ? 0 : 1;
+    }
+    if (!opt.batch.empty()) {
+        // one seed per instance unless asked; no shared incumbent file.
+        INCUMBENT_FILE.clear();
+        bool ok = run_batch(opt.batch, opt.num_jobs,
+                            opt.num_seeds > 0 ? opt.num_seeds : 1,
+                            opt.seeded ? opt.seed : 1, opt.bench_out);
+        print_stats(outFile);
+        return ok ? 0 : 1;
+    }
+
+    if (!opt.baseline_file.empty() &&
+        !read_solution(opt.baseline_file, baseline))
+        return 1;
+
+    // take the prepared instance from the cache, else prepare and cache it.
+    Instance in;
+    bool cached = false;
+    if (!opt.cache.empty()) {
+        PHASE_TIMER(PHASE_READ);
+        cached = read_cache(in, opt.filename, opt.cache);
+        if (!cached) in = Instance();
+    }
+    if (!cached) {
+        if (!prep_data(in, opt.filename)) {
+            cout << "Failed to prepare data!\n";
+            return 1;
+        }
+        if (!opt.cache.empty() && !write_cache(in, opt.filename, opt.cache))
+            cerr << opt.cache << ": cannot write the instance cache" << endl;
+    }
+    if (!opt.cache.empty())
+        outFile << "Instance cache " << (cached ? "loaded" : "written")
+                << endl;
+    Solver sv;
+    init_solver(sv, in, opt.seed);
+    set_deadline(sv, start);    /* the time limit includes the reading */
+    outFile << "Seed = " << opt.seed << endl;
+    if (!generate_initial(sv)) {
+        outFile << "Failed to generate an initial solution!" << endl;
+        print_solution(sv, baseline);
+        return 1;
+    }
+    outFile << "Initial Cost = " << sv.total_cost << endl;
+    search(sv);
+    if (!opt.events.empty()) {
+        // then reschedule online as the events come in.
+        outFile << "Offline Cost = " << sv.total_cost << endl;
+        if (opt.baseline_file.empty()) baseline = sv.assignments;
+        // the time limit is for the offline run only.
+        sv.deadline = chrono::steady_clock::time_point::max();
+        if (!reschedule_online(in, sv, opt.events)) return 1;
+    }
+    print_solution(sv, baseline);
+    outFile << "Total Cost = " << sv.total_cost << endl;
+    print_cost_breakdown(sv);
+    print_stats(outFile);
     return 0;
 }
 